@@ -0,0 +1,31 @@
+"""
+assets.py
+    Show a splash screen and text straight from a flash partition, nothing
+    is copied into the heap. Build the image with
+
+        python3 mkassets.py assets.bin logo=../image_bitmap/logo.py font=vga1_16x16.py
+
+    and write it to the partition labeled "assets", see mkassets.py.
+"""
+
+import lcd
+import tft_config
+
+LOGO_WIDTH = 320
+LOGO_HEIGHT = 170
+
+
+def main():
+    tft = tft_config.config()
+    tft.rotation(1)
+    assets = lcd.Assets("assets")
+    print(assets, assets.names())
+
+    tft.fill(0)
+    tft.bitmap(0, 0, LOGO_WIDTH, LOGO_HEIGHT, assets["logo"])
+    if "font" in assets:
+        font = assets["font"]
+        tft.text(font, "Hello from flash", 0, LOGO_HEIGHT + 10, 0xFFFF, 0x0000)
+
+
+main()
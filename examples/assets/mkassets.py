@@ -0,0 +1,139 @@
+"""
+mkassets.py
+    Pack fonts and images into an asset image for lcd.Assets. Runs on the
+    host with CPython 3.
+
+    python3 mkassets.py assets.bin logo=../image_bitmap/logo.py:rle vga16=vga1_16x16.py splash=splash.qoi
+
+    Every argument is name=path. A path ending in .py is a font or image
+    module: fonts (WIDTH/HEIGHT/FIRST/LAST/FONT, or MAP/WIDTHS/OFFSETS/BITMAPS)
+    are packed so text() can read them in place, images contribute their
+    BITMAP. With :rle after the path the BITMAP is run length encoded for
+    bitmap_compressed(). Any other file, e.g. a .qoi image, is stored as it is.
+
+    Write the image to a data partition, e.g. with a line like
+
+        assets,   data, 0x40,  ,  0x200000,
+
+    in partitions.csv and
+
+        parttool.py write_partition --partition-name assets --input assets.bin
+"""
+
+import struct
+import sys
+
+NAME_LEN = 24
+ENTRY_SIZE = NAME_LEN + 8
+FONT_HEADER_SIZE = 48
+
+
+def load_module(path):
+    env = {"const": lambda x: x}
+    with open(path) as f:
+        exec(f.read(), env)
+    return env
+
+
+def pack_font(m):
+    height = m["HEIGHT"]
+    if "MAP" in m:
+        if m.get("BPP", 1) != 1:
+            raise ValueError("only 1 bit fonts are supported")
+        width, first, last = 0, 0, 0
+        offset_width = m["OFFSET_WIDTH"]
+        sections = [m["MAP"].encode("utf-8"), bytes(m["WIDTHS"]), bytes(m["OFFSETS"]), bytes(m["BITMAPS"])]
+    else:
+        width, first, last = m["WIDTH"], m["FIRST"], m["LAST"]
+        offset_width = 0
+        sections = [b"", b"", b"", bytes(m["FONT"])]
+
+    header = bytearray(b"LCDF" + struct.pack("<BBBBII", height, width, offset_width, 0, first, last))
+    offset = FONT_HEADER_SIZE
+    for data in sections:
+        header += struct.pack("<II", offset, len(data))
+        offset += len(data)
+    return bytes(header) + b"".join(sections)
+
+
+def encode_rle(width, height, bitmap):
+    """The LCDR format of bitmap_compressed(): runs of one color, or up to
+    128 colors as they are."""
+    pixels = [bytes(bitmap[i:i + 2]) for i in range(0, width * height * 2, 2)]
+    out = bytearray(b"LCDR" + struct.pack("<HH", width, height))
+    literal = []
+
+    def flush():
+        if literal:
+            out.append(len(literal) - 1)
+            out.extend(b"".join(literal))
+            del literal[:]
+
+    i = 0
+    while i < len(pixels):
+        n = 1
+        while i + n < len(pixels) and n < 128 and pixels[i + n] == pixels[i]:
+            n += 1
+        if n >= 3:
+            flush()
+            out.append(0x80 | (n - 1))
+            out.extend(pixels[i])
+            i += n
+        else:
+            literal.append(pixels[i])
+            if len(literal) == 128:
+                flush()
+            i += 1
+    flush()
+    return bytes(out)
+
+
+def load(path):
+    rle = path.endswith(":rle")
+    if rle:
+        path = path[:-4]
+    m = load_module(path) if path.endswith(".py") else {}
+    if rle and "BITMAP" not in m:
+        raise ValueError("%s: only images can be RLE encoded" % path)
+    if not path.endswith(".py"):
+        with open(path, "rb") as f:
+            return f.read()
+    if "FONT" in m or "MAP" in m:
+        return pack_font(m)
+    if "BITMAP" in m:
+        print("%s: %d x %d" % (path, m["WIDTH"], m["HEIGHT"]))
+        if rle:
+            data = encode_rle(m["WIDTH"], m["HEIGHT"], m["BITMAP"])
+            print("%s: %d bytes RLE encoded, %.1fx" % (path, len(data), len(m["BITMAP"]) / len(data)))
+            return data
+        return bytes(m["BITMAP"])
+    raise ValueError("%s is neither a font nor an image" % path)
+
+
+def main(out, specs):
+    entries = []
+    for spec in specs:
+        name, path = spec.split("=", 1)
+        if len(name.encode()) > NAME_LEN:
+            raise ValueError("name too long: " + name)
+        entries.append((name, load(path)))
+
+    # entries start word aligned, the esp32 maps flash in 64 KB pages anyway
+    offset = 8 + len(entries) * ENTRY_SIZE
+    directory = bytearray(b"LCDA" + struct.pack("<I", len(entries)))
+    data = bytearray()
+    for name, blob in entries:
+        start = (offset + len(data) + 3) & ~3
+        data += bytes(start - offset - len(data)) + blob
+        directory += name.encode().ljust(NAME_LEN, b"\0") + struct.pack("<II", start, len(blob))
+
+    with open(out, "wb") as f:
+        f.write(directory)
+        f.write(data)
+    print("%s: %d entries, %d bytes" % (out, len(entries), len(directory) + len(data)))
+
+
+if len(sys.argv) < 3:
+    print(__doc__)
+    sys.exit(1)
+main(sys.argv[1], sys.argv[2:])
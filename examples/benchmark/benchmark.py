@@ -0,0 +1,309 @@
+"""
+benchmark.py
+    Measure the draw engine: pixels/s, bus transactions per frame and FPS
+    for fills, rects, circles, triangles, lines, bitmaps, compressed bitmaps,
+    vscroll and text.
+
+    On the device it uses tft_config.py, on the unix port an EmulatedPanel.
+    The emulated numbers measure the C code of the driver, not the bus, so
+    compare them with other unix runs only.
+
+    micropython benchmark.py [--json results.json] [--baseline old.json] [--tolerance 10]
+
+    With --baseline every benchmark whose pixels/s dropped by more than
+    --tolerance percent is reported and the script exits with status 1.
+"""
+
+import sys
+import time
+import json
+import framebuf
+import lcd
+from micropython import const
+
+# every benchmark runs at least this long and at least MIN_ROUNDS times
+MIN_TIME_US = const(1000000)
+MIN_ROUNDS = const(3)
+
+
+def make_tft():
+    if hasattr(lcd, "EmulatedPanel"):
+        panel = lcd.EmulatedPanel(width=240, height=536)
+        tft = lcd.RM67162(panel)
+        return tft, "emulated"
+    import tft_config
+    return tft_config.config(), "device"
+
+
+class Rand:
+    """Same sequence on every port, so runs stay comparable."""
+
+    def __init__(self, seed=1):
+        self.state = seed
+
+    def next(self, n):
+        self.state = (self.state * 1103515245 + 12345) & 0x7FFFFFFF
+        return (self.state >> 8) % n
+
+
+# Every benchmark draws one frame and returns the number of pixels it drew.
+
+def bench_fill(tft, w, h, rnd):
+    tft.fill(rnd.next(0x10000))
+    return w * h
+
+
+def bench_fill_rect(tft, w, h, rnd):
+    for _ in range(100):
+        tft.fill_rect(rnd.next(w - 32), rnd.next(h - 32), 32, 32, rnd.next(0x10000))
+    return 100 * 32 * 32
+
+
+def bench_rect(tft, w, h, rnd):
+    for _ in range(100):
+        tft.rect(rnd.next(w - 64), rnd.next(h - 64), 63, 63, rnd.next(0x10000))
+    return 100 * 4 * 64
+
+
+def bench_fill_circle(tft, w, h, rnd):
+    for _ in range(50):
+        tft.fill_circle(20 + rnd.next(w - 40), 20 + rnd.next(h - 40), 20, rnd.next(0x10000))
+    return 50 * 1257
+
+
+def bench_circle(tft, w, h, rnd):
+    for _ in range(50):
+        tft.circle(20 + rnd.next(w - 40), 20 + rnd.next(h - 40), 20, rnd.next(0x10000))
+    return 50 * 126
+
+
+def bench_lines(tft, w, h, rnd):
+    for _ in range(100):
+        tft.hline(rnd.next(w // 2), rnd.next(h), w // 2, rnd.next(0x10000))
+        tft.vline(rnd.next(w), rnd.next(h // 2), h // 2, rnd.next(0x10000))
+    return 100 * (w // 2 + h // 2)
+
+
+def bench_line(tft, w, h, rnd):
+    pixels = 0
+    for _ in range(100):
+        x0, y0, x1, y1 = rnd.next(w), rnd.next(h), rnd.next(w), rnd.next(h)
+        tft.line(x0, y0, x1, y1, rnd.next(0x10000))
+        pixels += max(abs(x1 - x0), abs(y1 - y0)) + 1
+    return pixels
+
+
+def bench_fill_triangle(tft, w, h, rnd):
+    for _ in range(50):
+        x, y = rnd.next(w - 40), rnd.next(h - 40)
+        tft.fill_triangle(x, y, x + 40, y, x, y + 40, rnd.next(0x10000))
+    return 50 * 800
+
+
+def bench_pixels(tft, w, h, rnd):
+    for _ in range(500):
+        tft.pixel(rnd.next(w), rnd.next(h), rnd.next(0x10000))
+    return 500
+
+
+class Bitmap:
+    def __init__(self, w, h):
+        self.buf = bytearray(w * h * 2)
+        fb = framebuf.FrameBuffer(self.buf, w, h, framebuf.RGB565)
+        for y in range(0, h, 8):
+            fb.fill_rect(0, y, w, 8, (y * 331) & 0xFFFF)
+
+
+def bench_bitmap_full(tft, w, h, rnd, state={}):
+    if "full" not in state:
+        state["full"] = Bitmap(w, h)
+    tft.bitmap(0, 0, w, h, state["full"].buf, lcd.RGB565)
+    return w * h
+
+
+def bench_bitmap_tiles(tft, w, h, rnd, state={}):
+    if "tile" not in state:
+        state["tile"] = Bitmap(32, 32)
+    buf = state["tile"].buf
+    for y in range(0, h - 31, 32):
+        for x in range(0, w - 31, 32):
+            tft.bitmap(x, y, x + 32, y + 32, buf, lcd.RGB565)
+    return (w // 32) * (h // 32) * 32 * 32
+
+
+def rle_stripes(w, h):
+    """The stripes of Bitmap as an RLE image for bitmap_compressed()."""
+    out = bytearray(b"LCDR")
+    out += bytes((w & 0xFF, w >> 8, h & 0xFF, h >> 8))
+    for y in range(0, h, 8):
+        color = (y * 331) & 0xFFFF
+        left = w * min(8, h - y)
+        while left:
+            n = min(left, 128)
+            out += bytes((0x80 | (n - 1), color >> 8, color & 0xFF))
+            left -= n
+    return out
+
+
+def bench_bitmap_rle(tft, w, h, rnd, state={}):
+    if "rle" not in state:
+        state["rle"] = rle_stripes(w, h)
+    tft.bitmap_compressed(0, 0, state["rle"])
+    return w * h
+
+
+def bench_vscroll(tft, w, h, rnd):
+    tft.vscroll_area(0, h, 0)
+    for line in range(0, h, 8):
+        tft.vscroll_start(line)
+    tft.vscroll_start(0)
+    return 0
+
+
+def bench_text(tft, w, h, rnd, state={}):
+    if "text" not in state:
+        buf = bytearray(w * 8 * 2)
+        state["text"] = (buf, framebuf.FrameBuffer(buf, w, 8, framebuf.RGB565))
+    buf, fb = state["text"]
+    for y in range(0, h - 7, 8):
+        fb.fill(0)
+        fb.text("The quick brown fox %d" % y, 0, 0, 0xFFFF)
+        tft.bitmap(0, y, w, y + 8, buf, lcd.RGB565)
+    return (h // 8) * w * 8
+
+
+class Font8x8:
+    """framebuf's built-in font as a romfont module for text()."""
+
+    def __init__(self):
+        self.WIDTH = 8
+        self.HEIGHT = 8
+        self.FIRST = 32
+        self.LAST = 127
+        font = bytearray(8 * 96)
+        glyph = bytearray(8)
+        fb = framebuf.FrameBuffer(glyph, 8, 8, framebuf.MONO_HLSB)
+        for code in range(32, 128):
+            fb.fill(0)
+            fb.text(chr(code), 0, 0, 1)
+            font[(code - 32) * 8:(code - 31) * 8] = glyph
+        self.FONT = bytes(font)
+
+
+def bench_font_text(tft, w, h, rnd, state={}):
+    if "font" not in state:
+        state["font"] = Font8x8()
+    font = state["font"]
+    pixels = 0
+    for y in range(0, h - 7, 8):
+        pixels += tft.text(font, "The quick brown fox %d" % y, 0, y, 0xFFFF, 0) * 8
+    return pixels
+
+
+BENCHMARKS = (
+    ("fill", bench_fill),
+    ("fill_rect", bench_fill_rect),
+    ("rect", bench_rect),
+    ("fill_circle", bench_fill_circle),
+    ("circle", bench_circle),
+    ("lines", bench_lines),
+    ("line", bench_line),
+    ("fill_triangle", bench_fill_triangle),
+    ("pixels", bench_pixels),
+    ("bitmap_full", bench_bitmap_full),
+    ("bitmap_tiles", bench_bitmap_tiles),
+    ("bitmap_rle", bench_bitmap_rle),
+    ("vscroll", bench_vscroll),
+    ("text", bench_text),
+    ("font_text", bench_font_text),
+)
+
+
+def run(tft, name, fn):
+    w = tft.width()
+    h = tft.height()
+    rnd = Rand()
+    fn(tft, w, h, rnd)  # warm up, allocate buffers
+    tft.wait()
+    tft.reset_stats()
+
+    rounds = 0
+    pixels = 0
+    start = time.ticks_us()
+    while True:
+        pixels += fn(tft, w, h, rnd)
+        rounds += 1
+        elapsed = time.ticks_diff(time.ticks_us(), start)
+        if rounds >= MIN_ROUNDS and elapsed >= MIN_TIME_US:
+            break
+    tft.wait()
+    elapsed = time.ticks_diff(time.ticks_us(), start)
+    stats = tft.stats()
+
+    return {
+        "name": name,
+        "rounds": rounds,
+        "us": elapsed,
+        "fps": rounds * 1000000 / elapsed,
+        "pixels_per_s": pixels * 1000000 / elapsed,
+        "transactions_per_frame": stats["transactions"] / rounds,
+        "bytes_per_frame": stats["bytes"] / rounds,
+    }
+
+
+def compare(results, baseline, tolerance):
+    old = {r["name"]: r for r in baseline["results"]}
+    failed = []
+    for r in results:
+        b = old.get(r["name"])
+        if b is None or b["pixels_per_s"] == 0:
+            continue
+        change = (r["pixels_per_s"] - b["pixels_per_s"]) * 100 / b["pixels_per_s"]
+        print("%-14s %+7.1f%%" % (r["name"], change))
+        if change < -tolerance:
+            failed.append(r["name"])
+    return failed
+
+
+def arg(name, default=None):
+    argv = getattr(sys, "argv", [])
+    if name in argv:
+        return argv[argv.index(name) + 1]
+    return default
+
+
+def main():
+    tft, mode = make_tft()
+    tft.init()
+
+    results = []
+    print("%-14s %12s %9s %10s %8s" % ("benchmark", "pixels/s", "fps", "trans/fr", "rounds"))
+    for name, fn in BENCHMARKS:
+        try:
+            r = run(tft, name, fn)
+        except MemoryError:
+            print("%-14s skipped, out of memory" % name)
+            continue
+        results.append(r)
+        print("%-14s %12d %9.1f %10.1f %8d" % (
+            name, r["pixels_per_s"], r["fps"], r["transactions_per_frame"], r["rounds"]))
+
+    report = {"mode": mode, "width": tft.width(), "height": tft.height(), "results": results}
+    path = arg("--json")
+    if path:
+        with open(path, "w") as f:
+            json.dump(report, f)
+    else:
+        print(json.dumps(report))
+
+    path = arg("--baseline")
+    if path:
+        with open(path) as f:
+            baseline = json.load(f)
+        failed = compare(results, baseline, float(arg("--tolerance", "10")))
+        if failed:
+            print("regressions:", ", ".join(failed))
+            sys.exit(1)
+
+
+main()
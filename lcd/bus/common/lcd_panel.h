@@ -6,7 +6,15 @@
 typedef struct _mp_lcd_panel_p_t {
     void (*tx_param)(mp_obj_base_t *self, int lcd_cmd, const void *param, size_t param_size);
     void (*tx_color)(mp_obj_base_t *self, int lcd_cmd, const void *color, size_t color_size);
+    void (*tx_pattern)(mp_obj_base_t *self, int lcd_cmd, const void *pattern, size_t pattern_size, size_t color_size);
     void (*deinit)(mp_obj_base_t *self);
+    void (*wait)(mp_obj_base_t *self);
+    bool (*busy)(mp_obj_base_t *self);
+    // schedule callback(arg) once everything sent so far is done, right away when it is
+    void (*notify)(mp_obj_base_t *self, mp_obj_t callback, mp_obj_t arg);
+    // obj holds the data of the next tx_color or tx_pattern, a bus that sends
+    // it without a copy keeps obj reachable until it is sent. May be NULL.
+    void (*source)(mp_obj_base_t *self, mp_obj_t obj);
 } mp_lcd_panel_p_t;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,18 @@
+#include "lcd_panel_stats.h"
+
+#include "py/obj.h"
+
+
+mp_obj_t lcd_stats_hist_dict(const lcd_stats_hist_t *hist) {
+    mp_obj_t buckets[LCD_STATS_BUCKETS];
+    for (int i = 0; i < LCD_STATS_BUCKETS; i++) {
+        buckets[i] = mp_obj_new_int_from_uint(hist->buckets[i]);
+    }
+
+    mp_obj_t dict = mp_obj_new_dict(4);
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_count), mp_obj_new_int_from_uint(hist->count));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_total_us), mp_obj_new_int_from_ull(hist->total_us));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_max_us), mp_obj_new_int_from_uint(hist->max_us));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_buckets), mp_obj_new_tuple(LCD_STATS_BUCKETS, buckets));
+    return dict;
+}
@@ -0,0 +1,36 @@
+#ifndef _LCD_PANEL_STATS_H_
+#define _LCD_PANEL_STATS_H_
+
+#include "py/obj.h"
+
+#include <stdint.h>
+
+// Latencies are counted in power of two buckets: bucket 0 holds 0 us,
+// bucket i holds [2^(i-1), 2^i) us and the last one everything from 16 ms on.
+#define LCD_STATS_BUCKETS (16)
+
+typedef struct _lcd_stats_hist_t {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[LCD_STATS_BUCKETS];
+} lcd_stats_hist_t;
+
+
+static inline void lcd_stats_hist_add(lcd_stats_hist_t *hist, uint32_t us) {
+    int bucket = us ? 32 - __builtin_clz(us) : 0;
+    if (bucket >= LCD_STATS_BUCKETS) {
+        bucket = LCD_STATS_BUCKETS - 1;
+    }
+    hist->buckets[bucket]++;
+    hist->count++;
+    hist->total_us += us;
+    if (us > hist->max_us) {
+        hist->max_us = us;
+    }
+}
+
+// {'count': n, 'total_us': t, 'max_us': m, 'buckets': (b0, b1, ...)}
+mp_obj_t lcd_stats_hist_dict(const lcd_stats_hist_t *hist);
+
+#endif
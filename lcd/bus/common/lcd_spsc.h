@@ -0,0 +1,84 @@
+#ifndef _LCD_SPSC_H_
+#define _LCD_SPSC_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Lock-free ring for exactly one producer and one consumer, which may run on
+// different cores. It only hands out slot indices, the caller keeps the
+// entries in an array of `size` elements.
+//
+// head and tail count every push and pop since init and are never masked, so
+// they double as sequence numbers: the n-th entry pushed has sequence n (from
+// 1 on), and it is done once the consumer popped it, see lcd_spsc_done().
+// A producer uses them as fences: remember the sequence of the last entry
+// reading a buffer, and the buffer is free again once that entry is done.
+
+typedef struct _lcd_spsc_t {
+    atomic_uint_fast32_t head; // written by the producer only
+    atomic_uint_fast32_t tail; // written by the consumer only
+    uint32_t mask;             // size - 1, size is a power of two
+} lcd_spsc_t;
+
+
+static inline void lcd_spsc_init(lcd_spsc_t *q, uint32_t size) {
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    q->mask = size - 1;
+}
+
+
+// Entries pushed and not yet popped. Exact on either side as long as the
+// other one does not move at the same time, never too low for the producer.
+static inline uint32_t lcd_spsc_count(lcd_spsc_t *q) {
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    return head - tail;
+}
+
+
+// Producer: slot to fill next, -1 when the ring is full.
+static inline int lcd_spsc_reserve(lcd_spsc_t *q) {
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (head - tail > q->mask) {
+        return -1;
+    }
+    return head & q->mask;
+}
+
+
+// Producer: publish the reserved slot, returns its sequence number.
+static inline uint32_t lcd_spsc_push(lcd_spsc_t *q) {
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed) + 1;
+    atomic_store_explicit(&q->head, head, memory_order_release);
+    return head;
+}
+
+
+// Consumer: slot of the oldest entry, -1 when the ring is empty.
+static inline int lcd_spsc_front(lcd_spsc_t *q) {
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (head == tail) {
+        return -1;
+    }
+    return tail & q->mask;
+}
+
+
+// Consumer: release the oldest entry once it is no longer used.
+static inline void lcd_spsc_pop(lcd_spsc_t *q) {
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed) + 1;
+    atomic_store_explicit(&q->tail, tail, memory_order_release);
+}
+
+
+// Producer: whether the entry with sequence seq was popped.
+static inline bool lcd_spsc_done(lcd_spsc_t *q, uint32_t seq) {
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    return (int32_t)(tail - seq) >= 0;
+}
+
+#endif
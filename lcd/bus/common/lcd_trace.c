@@ -0,0 +1,125 @@
+#include "lcd_trace.h"
+
+#if LCD_TRACE
+
+#include "mphalport.h"
+
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/stream.h"
+
+typedef struct _lcd_trace_event_t {
+    uint32_t ts;    // mp_hal_ticks_us()
+    uint32_t bytes; // moved by the traced call, 0 if it does not apply
+    uint16_t name;  // qstr
+    uint8_t track;
+    char phase;     // 'B' or 'E'
+} lcd_trace_event_t;
+
+bool lcd_trace_enabled;
+
+STATIC lcd_trace_event_t lcd_trace_ring[LCD_TRACE_EVENTS];
+STATIC size_t lcd_trace_head;  // next slot to write
+STATIC size_t lcd_trace_count; // valid events, up to LCD_TRACE_EVENTS
+
+STATIC const char *const lcd_trace_track_names[] = {
+    [LCD_TRACE_DRIVER] = "driver",
+    [LCD_TRACE_BUS]    = "bus",
+    [LCD_TRACE_DMA]    = "dma",
+};
+
+
+void lcd_trace_record(qstr name, uint8_t track, char phase, uint32_t bytes) {
+    lcd_trace_record_at(name, track, phase, bytes, mp_hal_ticks_us());
+}
+
+
+// ts is in mp_hal_ticks_us() and may lie before events already recorded.
+void lcd_trace_record_at(qstr name, uint8_t track, char phase, uint32_t bytes, uint32_t ts) {
+    lcd_trace_event_t *ev = &lcd_trace_ring[lcd_trace_head];
+    ev->ts = ts;
+    ev->bytes = bytes;
+    ev->name = name;
+    ev->track = track;
+    ev->phase = phase;
+
+    lcd_trace_head = (lcd_trace_head + 1) % LCD_TRACE_EVENTS;
+    if (lcd_trace_count < LCD_TRACE_EVENTS) {
+        lcd_trace_count++;
+    }
+}
+
+
+// Forget what was recorded and start recording.
+STATIC mp_obj_t lcd_trace_start(void) {
+    lcd_trace_head = 0;
+    lcd_trace_count = 0;
+    lcd_trace_enabled = true;
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_0(lcd_trace_start_obj, lcd_trace_start);
+
+
+STATIC mp_obj_t lcd_trace_stop(void) {
+    lcd_trace_enabled = false;
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_0(lcd_trace_stop_obj, lcd_trace_stop);
+
+
+// Write the ring, oldest event first, in the Chrome trace_event JSON format.
+// Timestamps count from the earliest event, so the wrap of ticks_us is harmless.
+STATIC void lcd_trace_print(const mp_print_t *print) {
+    size_t first = (lcd_trace_head + LCD_TRACE_EVENTS - lcd_trace_count) % LCD_TRACE_EVENTS;
+    uint32_t start = lcd_trace_ring[first].ts;
+    for (size_t i = 1; i < lcd_trace_count; i++) {
+        uint32_t ts = lcd_trace_ring[(first + i) % LCD_TRACE_EVENTS].ts;
+        if ((int32_t)(ts - start) < 0) {
+            start = ts;
+        }
+    }
+
+    mp_print_str(print, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < MP_ARRAY_SIZE(lcd_trace_track_names); i++) {
+        mp_printf(print, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}%s\n",
+            (unsigned)i, lcd_trace_track_names[i], (i + 1 < MP_ARRAY_SIZE(lcd_trace_track_names) || lcd_trace_count) ? "," : "");
+    }
+    for (size_t i = 0; i < lcd_trace_count; i++) {
+        const lcd_trace_event_t *ev = &lcd_trace_ring[(first + i) % LCD_TRACE_EVENTS];
+        mp_printf(print, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%u,\"pid\":1,\"tid\":%u",
+            qstr_str(ev->name), ev->phase, (unsigned)(ev->ts - start), ev->track);
+        if (ev->bytes) {
+            mp_printf(print, ",\"args\":{\"bytes\":%u}", (unsigned)ev->bytes);
+        }
+        mp_print_str(print, (i + 1 < lcd_trace_count) ? "},\n" : "}\n");
+    }
+    mp_print_str(print, "]}\n");
+}
+
+
+// trace_dump() returns the JSON as a str, trace_dump(stream) writes it to
+// the stream instead, which needs far less memory for a full ring.
+STATIC mp_obj_t lcd_trace_dump(size_t n_args, const mp_obj_t *args_in) {
+    bool enabled = lcd_trace_enabled;
+    lcd_trace_enabled = false;
+
+    if (n_args == 1) {
+        mp_get_stream_raise(args_in[0], MP_STREAM_OP_WRITE);
+        mp_print_t print = { MP_OBJ_TO_PTR(args_in[0]), mp_stream_write_adaptor };
+        lcd_trace_print(&print);
+        lcd_trace_enabled = enabled;
+        return mp_const_none;
+    }
+
+    vstr_t vstr;
+    mp_print_t print;
+    vstr_init_print(&vstr, 64 + lcd_trace_count * 64, &print);
+    lcd_trace_print(&print);
+    lcd_trace_enabled = enabled;
+    mp_obj_t json = mp_obj_new_str(vstr.buf, vstr.len);
+    vstr_clear(&vstr);
+    return json;
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(lcd_trace_dump_obj, 0, 1, lcd_trace_dump);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef _LCD_TRACE_H_
+#define _LCD_TRACE_H_
+
+#include "py/obj.h"
+
+#include <stdint.h>
+
+// Build with LCD_TRACE=0 to leave the tracer out. When it is compiled in but
+// not started, every trace point costs a load and a branch.
+#ifndef LCD_TRACE
+#define LCD_TRACE (1)
+#endif
+
+// events kept in the ring, the oldest are overwritten (12 bytes each)
+#ifndef LCD_TRACE_EVENTS
+#define LCD_TRACE_EVENTS (512)
+#endif
+
+// tracks, shown as threads in the trace viewer
+#define LCD_TRACE_DRIVER (0)
+#define LCD_TRACE_BUS    (1)
+#define LCD_TRACE_DMA    (2) // queued transfers, recorded once they are done
+
+#if LCD_TRACE
+
+extern bool lcd_trace_enabled;
+
+void lcd_trace_record(qstr name, uint8_t track, char phase, uint32_t bytes);
+void lcd_trace_record_at(qstr name, uint8_t track, char phase, uint32_t bytes, uint32_t ts);
+
+#define LCD_TRACE_BEGIN(name, track) \
+    do { if (lcd_trace_enabled) { lcd_trace_record(name, track, 'B', 0); } } while (0)
+#define LCD_TRACE_END(name, track, bytes) \
+    do { if (lcd_trace_enabled) { lcd_trace_record(name, track, 'E', bytes); } } while (0)
+
+MP_DECLARE_CONST_FUN_OBJ_0(lcd_trace_start_obj);
+MP_DECLARE_CONST_FUN_OBJ_0(lcd_trace_stop_obj);
+MP_DECLARE_CONST_FUN_OBJ_VAR_BETWEEN(lcd_trace_dump_obj);
+
+#else
+
+#define LCD_TRACE_BEGIN(name, track)
+#define LCD_TRACE_END(name, track, bytes)
+
+#endif
+
+#endif
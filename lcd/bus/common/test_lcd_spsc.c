@@ -0,0 +1,85 @@
+// Stress test of the ring with a producer and a consumer thread, the way the
+// flush worker uses it: entries must come out in order, and a buffer fenced
+// with the sequence of its last entry must not be reused while that entry is
+// still queued. Build and run with `make -C lcd test`.
+
+#include "lcd_spsc.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#define ENTRIES (1000000u)
+#define SIZE    (16)
+#define BUFFERS (4)
+
+static lcd_spsc_t queue;
+static uint64_t slots[SIZE];       // entry n refers to buffer n % BUFFERS
+static uint64_t buffers[BUFFERS];  // the entry that owns the buffer writes its number into it
+static uint32_t buffer_seq[BUFFERS];
+static atomic_int failed;      // either side stops when the other one failed
+
+
+static void *consumer(void *arg) {
+    (void)arg;
+    for (uint64_t n = 1; n <= ENTRIES; n++) {
+        int i;
+        while ((i = lcd_spsc_front(&queue)) < 0) {
+            if (failed) {
+                return NULL;
+            }
+            sched_yield();
+        }
+        uint64_t entry = slots[i];
+        if (entry != n) {
+            printf("FAIL entry %llu out of order, expected %llu\n", (unsigned long long)entry, (unsigned long long)n);
+            failed = 1;
+            return NULL;
+        }
+        if (buffers[entry % BUFFERS] != entry) {
+            printf("FAIL buffer of entry %llu reused while queued\n", (unsigned long long)entry);
+            failed = 1;
+            return NULL;
+        }
+        lcd_spsc_pop(&queue);
+    }
+    return NULL;
+}
+
+
+int main(void) {
+    pthread_t thread;
+
+    lcd_spsc_init(&queue, SIZE);
+    pthread_create(&thread, NULL, consumer, NULL);
+
+    for (uint64_t n = 1; n <= ENTRIES && !failed; n++) {
+        int b = n % BUFFERS;
+        while (!lcd_spsc_done(&queue, buffer_seq[b]) && !failed) {
+            sched_yield();
+        }
+        buffers[b] = n;
+
+        int i;
+        while ((i = lcd_spsc_reserve(&queue)) < 0 && !failed) {
+            sched_yield();
+        }
+        if (i < 0) {
+            break;
+        }
+        slots[i] = n;
+        buffer_seq[b] = lcd_spsc_push(&queue);
+        if (buffer_seq[b] != (uint32_t)n) {
+            printf("FAIL sequence %u, expected %u\n", (unsigned)buffer_seq[b], (unsigned)n);
+            failed = 1;
+        }
+    }
+    pthread_join(thread, NULL);
+
+    if (!failed && lcd_spsc_count(&queue) != 0) {
+        printf("FAIL %u entries left\n", (unsigned)lcd_spsc_count(&queue));
+        failed = 1;
+    }
+    printf("lcd_spsc: %u entries, %s\n", ENTRIES, failed ? "failed" : "ok");
+    return failed;
+}
@@ -0,0 +1,663 @@
+#include "emulated_panel.h"
+#include "lcd_panel.h"
+#include "lcd_panel_commands.h"
+
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/gc.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum {
+    EMULATED_PANEL_TRANS_PARAM,
+    EMULATED_PANEL_TRANS_COLOR,
+    EMULATED_PANEL_TRANS_PATTERN,
+};
+
+
+STATIC void emulated_panel_reset_state(mp_lcd_emulated_panel_obj_t *self)
+{
+    self->madctl_val  = 0;
+    self->pixel_bytes = 2;
+    self->x_start     = 0;
+    self->x_end       = self->width - 1;
+    self->y_start     = 0;
+    self->y_end       = self->height - 1;
+    self->x           = 0;
+    self->y           = 0;
+    self->tfa         = 0;
+    self->vsa         = self->height;
+    self->bfa         = 0;
+    self->vssa        = 0;
+}
+
+
+STATIC void emulated_panel_reset_stats(mp_lcd_emulated_panel_obj_t *self)
+{
+    self->param_transactions = 0;
+    self->color_transactions = 0;
+    self->param_bytes        = 0;
+    self->color_bytes        = 0;
+}
+
+
+STATIC void mp_lcd_emulated_panel_print(const mp_print_t *print,
+                                        mp_obj_t          self_in,
+                                        mp_print_kind_t   kind)
+{
+    (void) kind;
+    mp_lcd_emulated_panel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_printf(
+        print,
+        "<Emulated Panel width=%u, height=%u, madctl=0x%02x, bpp=%u, queued=%u>",
+        self->width,
+        self->height,
+        self->madctl_val,
+        self->pixel_bytes * 8,
+        self->queued
+    );
+}
+
+
+STATIC mp_obj_t mp_lcd_emulated_panel_make_new(const mp_obj_type_t *type,
+                                               size_t               n_args,
+                                               size_t               n_kw,
+                                               const mp_obj_t      *all_args)
+{
+    enum {
+        ARG_width,
+        ARG_height,
+        ARG_queued
+    };
+    const mp_arg_t make_new_args[] = {
+        { MP_QSTR_width,            MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 240        } },
+        { MP_QSTR_height,           MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 240        } },
+        { MP_QSTR_queued,           MP_ARG_BOOL | MP_ARG_KW_ONLY, {.u_bool = false    }  },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(make_new_args)];
+    mp_arg_parse_all_kw_array(
+        n_args,
+        n_kw,
+        all_args,
+        MP_ARRAY_SIZE(make_new_args),
+        make_new_args, args
+    );
+
+    if (args[ARG_width].u_int <= 0 || args[ARG_height].u_int <= 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid panel size"));
+    }
+
+    // create new object
+    mp_lcd_emulated_panel_obj_t *self = m_new_obj(mp_lcd_emulated_panel_obj_t);
+    self->base.type = &mp_lcd_emulated_panel_type;
+    self->width     = args[ARG_width].u_int;
+    self->height    = args[ARG_height].u_int;
+    self->queued    = args[ARG_queued].u_bool;
+
+    // 3 bytes for each pixel, colors are stored as RGB888 whatever COLMOD says
+    self->gram_size = self->width * self->height * 3;
+    self->gram = gc_alloc(self->gram_size, 0);
+    if (self->gram == NULL) {
+        mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Failed to allocate GRAM."));
+    }
+    memset(self->gram, 0, self->gram_size);
+
+    self->trans_head = 0;
+    self->trans_pending = 0;
+    self->trans_seq = 0;
+    for (int i = 0; i < EMULATED_PANEL_NOTIFY_DEPTH; i++) {
+        self->notify_seq[i] = 0;
+        self->notify_cb[i] = mp_const_none;
+        self->notify_arg[i] = mp_const_none;
+    }
+
+    emulated_panel_reset_state(self);
+    emulated_panel_reset_stats(self);
+    return MP_OBJ_FROM_PTR(self);
+}
+
+
+// Translate a logical (column, row) address into a GRAM offset the way the
+// MADCTL MX/MY/MV bits would, returns -1 for addresses outside the panel.
+STATIC int emulated_panel_gram_offset(mp_lcd_emulated_panel_obj_t *self, int col, int row)
+{
+    int width = self->width;
+    int height = self->height;
+
+    if (self->madctl_val & LCD_CMD_MV_BIT) {
+        width = self->height;
+        height = self->width;
+    }
+    if (col >= width || row >= height) {
+        return -1;
+    }
+    if (self->madctl_val & LCD_CMD_MX_BIT) {
+        col = width - 1 - col;
+    }
+    if (self->madctl_val & LCD_CMD_MY_BIT) {
+        row = height - 1 - row;
+    }
+    if (self->madctl_val & LCD_CMD_MV_BIT) {
+        int t = col;
+        col = row;
+        row = t;
+    }
+    return (row * self->width + col) * 3;
+}
+
+
+STATIC void emulated_panel_write_pixel(mp_lcd_emulated_panel_obj_t *self, const uint8_t *p)
+{
+    int offset = emulated_panel_gram_offset(self, self->x, self->y);
+    if (offset >= 0) {
+        uint8_t *gram = self->gram + offset;
+        if (self->pixel_bytes == 2) {
+            uint16_t c = (p[0] << 8) | p[1];
+            gram[0] = ((c >> 8) & 0xF8) | (c >> 13);
+            gram[1] = ((c >> 3) & 0xFC) | ((c >> 9) & 0x03);
+            gram[2] = ((c << 3) & 0xF8) | ((c >> 2) & 0x07);
+        } else {
+            gram[0] = p[0];
+            gram[1] = p[1];
+            gram[2] = p[2];
+        }
+    }
+
+    // the write cursor wraps inside the window like the real GRAM does
+    if (self->x++ >= self->x_end) {
+        self->x = self->x_start;
+        if (self->y++ >= self->y_end) {
+            self->y = self->y_start;
+        }
+    }
+}
+
+
+STATIC void emulated_panel_apply_param(mp_lcd_emulated_panel_obj_t *self,
+                                       int                          lcd_cmd,
+                                       const uint8_t               *p,
+                                       size_t                       param_size)
+{
+    switch (lcd_cmd) {
+        case LCD_CMD_SWRESET:
+            emulated_panel_reset_state(self);
+        break;
+
+        case LCD_CMD_CASET:
+            if (param_size >= 4) {
+                self->x_start = (p[0] << 8) | p[1];
+                self->x_end   = (p[2] << 8) | p[3];
+            }
+        break;
+
+        case LCD_CMD_RASET:
+            if (param_size >= 4) {
+                self->y_start = (p[0] << 8) | p[1];
+                self->y_end   = (p[2] << 8) | p[3];
+            }
+        break;
+
+        case LCD_CMD_RAMWR:
+            self->x = self->x_start;
+            self->y = self->y_start;
+        break;
+
+        case LCD_CMD_MADCTL:
+            if (param_size >= 1) {
+                self->madctl_val = p[0];
+            }
+        break;
+
+        case LCD_CMD_COLMOD:
+            if (param_size >= 1) {
+                self->pixel_bytes = ((p[0] & 0x07) == 0x05) ? 2 : 3;
+            }
+        break;
+
+        case LCD_CMD_VSCRDEF:
+            if (param_size >= 6) {
+                self->tfa = (p[0] << 8) | p[1];
+                self->vsa = (p[2] << 8) | p[3];
+                self->bfa = (p[4] << 8) | p[5];
+            }
+        break;
+
+        case LCD_CMD_VSCSAD:
+            if (param_size >= 2) {
+                self->vssa = (p[0] << 8) | p[1];
+            }
+        break;
+
+        default:
+        break;
+    }
+}
+
+
+STATIC void emulated_panel_apply_color(mp_lcd_emulated_panel_obj_t *self,
+                                       const uint8_t               *p,
+                                       size_t                       color_size)
+{
+    if (self->gram == NULL) {
+        return;
+    }
+
+    // like the QSPI bus, every color transfer starts with a memory write
+    self->x = self->x_start;
+    self->y = self->y_start;
+    for (size_t i = 0; i + self->pixel_bytes <= color_size; i += self->pixel_bytes) {
+        emulated_panel_write_pixel(self, p + i);
+    }
+}
+
+
+STATIC void emulated_panel_apply_pattern(mp_lcd_emulated_panel_obj_t *self,
+                                         const uint8_t               *p,
+                                         size_t                       pattern_size,
+                                         size_t                       color_size)
+{
+    uint8_t pixel[3];
+
+    if (self->gram == NULL || pattern_size == 0) {
+        return;
+    }
+
+    self->x = self->x_start;
+    self->y = self->y_start;
+    for (size_t i = 0; i + self->pixel_bytes <= color_size; i += self->pixel_bytes) {
+        for (int j = 0; j < self->pixel_bytes; j++) {
+            pixel[j] = p[(i + j) % pattern_size];
+        }
+        emulated_panel_write_pixel(self, pixel);
+    }
+}
+
+
+// Schedule the notify() callbacks whose transaction is done.
+STATIC void emulated_panel_notify_check(mp_lcd_emulated_panel_obj_t *self)
+{
+    uint32_t completed = self->trans_seq - self->trans_pending;
+    for (int i = 0; i < EMULATED_PANEL_NOTIFY_DEPTH; i++) {
+        uint32_t seq = self->notify_seq[i];
+        if (seq != 0 && (int32_t)(completed - seq) >= 0) {
+            self->notify_seq[i] = 0;
+            mp_sched_schedule(self->notify_cb[i], self->notify_arg[i]);
+        }
+    }
+}
+
+
+// Complete the oldest pending transaction, as if the dma had sent it.
+STATIC void emulated_panel_step(mp_lcd_emulated_panel_obj_t *self)
+{
+    emulated_panel_trans_t *t = &self->trans[self->trans_head];
+
+    switch (t->kind) {
+        case EMULATED_PANEL_TRANS_PARAM:
+            emulated_panel_apply_param(self, t->lcd_cmd, t->data, t->data_size);
+        break;
+
+        case EMULATED_PANEL_TRANS_COLOR:
+            emulated_panel_apply_color(self, t->data, t->data_size);
+        break;
+
+        default:
+            emulated_panel_apply_pattern(self, t->data, t->data_size, t->color_size);
+        break;
+    }
+    if (t->data) {
+        m_del(uint8_t, t->data, t->data_size);
+        t->data = NULL;
+    }
+    self->trans_head = (self->trans_head + 1) % EMULATED_PANEL_QUEUE_DEPTH;
+    self->trans_pending--;
+    emulated_panel_notify_check(self);
+}
+
+
+// Hold a copy of a transaction back until wait(), busy() or step(). A full
+// queue completes the oldest one first, like the QSPI bus reaps it.
+STATIC void emulated_panel_queue(mp_lcd_emulated_panel_obj_t *self,
+                                 uint8_t                      kind,
+                                 int                          lcd_cmd,
+                                 const void                  *data,
+                                 size_t                       data_size,
+                                 size_t                       color_size)
+{
+    if (self->trans_pending == EMULATED_PANEL_QUEUE_DEPTH) {
+        emulated_panel_step(self);
+    }
+
+    emulated_panel_trans_t *t = &self->trans[(self->trans_head + self->trans_pending) % EMULATED_PANEL_QUEUE_DEPTH];
+    t->kind = kind;
+    t->lcd_cmd = lcd_cmd;
+    t->data = NULL;
+    t->data_size = data_size;
+    t->color_size = color_size;
+    if (data_size) {
+        t->data = m_new(uint8_t, data_size);
+        memcpy(t->data, data, data_size);
+    }
+    self->trans_pending++;
+    self->trans_seq++;
+}
+
+
+void emulated_panel_tx_param(mp_obj_base_t *self_in,
+                             int            lcd_cmd,
+                             const void    *param,
+                             size_t         param_size)
+{
+    mp_lcd_emulated_panel_obj_t *self = (mp_lcd_emulated_panel_obj_t *)self_in;
+
+    self->param_transactions++;
+    self->param_bytes += param_size;
+    if (self->queued) {
+        emulated_panel_queue(self, EMULATED_PANEL_TRANS_PARAM, lcd_cmd, param, param_size, 0);
+    } else {
+        emulated_panel_apply_param(self, lcd_cmd, param, param_size);
+    }
+}
+
+
+void emulated_panel_tx_color(mp_obj_base_t *self_in,
+                             int            lcd_cmd,
+                             const void    *color,
+                             size_t         color_size)
+{
+    mp_lcd_emulated_panel_obj_t *self = (mp_lcd_emulated_panel_obj_t *)self_in;
+
+    self->color_transactions++;
+    self->color_bytes += color_size;
+    if (self->queued) {
+        emulated_panel_queue(self, EMULATED_PANEL_TRANS_COLOR, lcd_cmd, color, color_size, color_size);
+    } else {
+        emulated_panel_apply_color(self, color, color_size);
+    }
+}
+
+
+void emulated_panel_tx_pattern(mp_obj_base_t *self_in,
+                               int            lcd_cmd,
+                               const void    *pattern,
+                               size_t         pattern_size,
+                               size_t         color_size)
+{
+    mp_lcd_emulated_panel_obj_t *self = (mp_lcd_emulated_panel_obj_t *)self_in;
+
+    self->color_transactions++;
+    self->color_bytes += color_size;
+    if (self->queued) {
+        emulated_panel_queue(self, EMULATED_PANEL_TRANS_PATTERN, lcd_cmd, pattern, pattern_size, color_size);
+    } else {
+        emulated_panel_apply_pattern(self, pattern, pattern_size, color_size);
+    }
+}
+
+
+void emulated_panel_wait(mp_obj_base_t *self_in)
+{
+    mp_lcd_emulated_panel_obj_t *self = (mp_lcd_emulated_panel_obj_t *)self_in;
+
+    while (self->trans_pending > 0) {
+        emulated_panel_step(self);
+    }
+}
+
+
+// Every call completes one pending transaction, so a loop polling busy()
+// ends the way it does on real hardware.
+bool emulated_panel_busy(mp_obj_base_t *self_in)
+{
+    mp_lcd_emulated_panel_obj_t *self = (mp_lcd_emulated_panel_obj_t *)self_in;
+
+    if (self->trans_pending > 0) {
+        emulated_panel_step(self);
+    }
+    return self->trans_pending > 0;
+}
+
+
+void emulated_panel_notify(mp_obj_base_t *self_in, mp_obj_t callback, mp_obj_t arg)
+{
+    mp_lcd_emulated_panel_obj_t *self = (mp_lcd_emulated_panel_obj_t *)self_in;
+
+    if (self->trans_pending == 0) {
+        mp_sched_schedule(callback, arg);
+        return;
+    }
+    int i = 0;
+    while (self->notify_seq[i] != 0) {
+        if (++i == EMULATED_PANEL_NOTIFY_DEPTH) {
+            mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("too many pending notify() calls"));
+        }
+    }
+    self->notify_cb[i] = callback;
+    self->notify_arg[i] = arg;
+    self->notify_seq[i] = self->trans_seq;
+}
+
+
+void emulated_panel_deinit(mp_obj_base_t *self_in)
+{
+    mp_lcd_emulated_panel_obj_t *self = (mp_lcd_emulated_panel_obj_t *)self_in;
+
+    emulated_panel_wait(self_in);
+    if (self->gram) {
+        gc_free(self->gram);
+        self->gram = NULL;
+        self->gram_size = 0;
+    }
+}
+
+
+STATIC mp_obj_t mp_lcd_emulated_panel_tx_param(size_t n_args, const mp_obj_t *args_in)
+{
+    mp_obj_base_t *self = (mp_obj_base_t *)MP_OBJ_TO_PTR(args_in[0]);
+    int cmd = mp_obj_get_int(args_in[1]);
+    if (n_args == 3) {
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(args_in[2], &bufinfo, MP_BUFFER_READ);
+        emulated_panel_tx_param(self, cmd, bufinfo.buf, bufinfo.len);
+    } else {
+        emulated_panel_tx_param(self, cmd, NULL, 0);
+    }
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_emulated_panel_tx_param_obj, 2, 3, mp_lcd_emulated_panel_tx_param);
+
+
+STATIC mp_obj_t mp_lcd_emulated_panel_tx_color(size_t n_args, const mp_obj_t *args_in)
+{
+    mp_obj_base_t *self = (mp_obj_base_t *)MP_OBJ_TO_PTR(args_in[0]);
+    int cmd = mp_obj_get_int(args_in[1]);
+
+    if (n_args == 3) {
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(args_in[2], &bufinfo, MP_BUFFER_READ);
+        emulated_panel_tx_color(self, cmd, bufinfo.buf, bufinfo.len);
+    } else {
+        emulated_panel_tx_color(self, cmd, NULL, 0);
+    }
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_emulated_panel_tx_color_obj, 2, 3, mp_lcd_emulated_panel_tx_color);
+
+
+STATIC mp_obj_t mp_lcd_emulated_panel_wait(mp_obj_t self_in)
+{
+    mp_obj_base_t *self = (mp_obj_base_t *)MP_OBJ_TO_PTR(self_in);
+
+    emulated_panel_wait(self);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_emulated_panel_wait_obj, mp_lcd_emulated_panel_wait);
+
+
+STATIC mp_obj_t mp_lcd_emulated_panel_busy(mp_obj_t self_in)
+{
+    mp_obj_base_t *self = (mp_obj_base_t *)MP_OBJ_TO_PTR(self_in);
+
+    return mp_obj_new_bool(emulated_panel_busy(self));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_emulated_panel_busy_obj, mp_lcd_emulated_panel_busy);
+
+
+// Complete up to n pending transactions (1 by default), returns how many
+// are still pending.
+STATIC mp_obj_t mp_lcd_emulated_panel_step(size_t n_args, const mp_obj_t *args_in)
+{
+    mp_lcd_emulated_panel_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    mp_int_t n = 1;
+    if (n_args == 2) {
+        n = mp_obj_get_int(args_in[1]);
+    }
+
+    while (n-- > 0 && self->trans_pending > 0) {
+        emulated_panel_step(self);
+    }
+    return MP_OBJ_NEW_SMALL_INT(self->trans_pending);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_emulated_panel_step_obj, 1, 2, mp_lcd_emulated_panel_step);
+
+
+// Returns what the panel currently shows as a binary PPM image, with the
+// vertical scroll offset and the BGR order applied.
+STATIC mp_obj_t mp_lcd_emulated_panel_dump_ppm(mp_obj_t self_in)
+{
+    mp_lcd_emulated_panel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    if (self->gram == NULL) {
+        mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("panel is deinitialized"));
+    }
+
+    char header[32];
+    int header_len = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", self->width, self->height);
+    size_t len = header_len + self->gram_size;
+    uint8_t *buf = m_new(uint8_t, len);
+    memcpy(buf, header, header_len);
+
+    bool bgr = self->madctl_val & LCD_CMD_BGR_BIT;
+    int tfa = self->tfa;
+    int vsa = self->vsa;
+    uint8_t *out = buf + header_len;
+    for (int row = 0; row < self->height; row++) {
+        int src_row = row;
+        if (vsa > 0 && row >= tfa && row < tfa + vsa) {
+            int offset = ((row - tfa) + (self->vssa - tfa)) % vsa;
+            if (offset < 0) {
+                offset += vsa;
+            }
+            src_row = tfa + offset;
+        }
+        if (src_row >= self->height) {
+            src_row = row;
+        }
+        const uint8_t *in = self->gram + src_row * self->width * 3;
+        for (int col = 0; col < self->width; col++) {
+            out[0] = bgr ? in[2] : in[0];
+            out[1] = in[1];
+            out[2] = bgr ? in[0] : in[2];
+            out += 3;
+            in += 3;
+        }
+    }
+
+    mp_obj_t ppm = mp_obj_new_bytes(buf, len);
+    m_del(uint8_t, buf, len);
+    return ppm;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_emulated_panel_dump_ppm_obj, mp_lcd_emulated_panel_dump_ppm);
+
+
+STATIC mp_obj_t mp_lcd_emulated_panel_stats(mp_obj_t self_in)
+{
+    mp_lcd_emulated_panel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_obj_t stats = mp_obj_new_dict(6);
+
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_transactions),
+        mp_obj_new_int_from_uint(self->param_transactions + self->color_transactions));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_bytes),
+        mp_obj_new_int_from_ull(self->param_bytes + self->color_bytes));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_tx_param),
+        mp_obj_new_int_from_uint(self->param_transactions));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_tx_color),
+        mp_obj_new_int_from_uint(self->color_transactions));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_param_bytes),
+        mp_obj_new_int_from_ull(self->param_bytes));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_color_bytes),
+        mp_obj_new_int_from_ull(self->color_bytes));
+    return stats;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_emulated_panel_stats_obj, mp_lcd_emulated_panel_stats);
+
+
+STATIC mp_obj_t mp_lcd_emulated_panel_reset_stats(mp_obj_t self_in)
+{
+    mp_lcd_emulated_panel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    emulated_panel_reset_stats(self);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_emulated_panel_reset_stats_obj, mp_lcd_emulated_panel_reset_stats);
+
+
+STATIC mp_obj_t mp_lcd_emulated_panel_deinit(mp_obj_t self_in)
+{
+    mp_obj_base_t *self = (mp_obj_base_t *)MP_OBJ_TO_PTR(self_in);
+
+    emulated_panel_deinit(self);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_emulated_panel_deinit_obj, mp_lcd_emulated_panel_deinit);
+
+
+STATIC const mp_rom_map_elem_t mp_lcd_emulated_panel_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_tx_param),    MP_ROM_PTR(&mp_lcd_emulated_panel_tx_param_obj)    },
+    { MP_ROM_QSTR(MP_QSTR_tx_color),    MP_ROM_PTR(&mp_lcd_emulated_panel_tx_color_obj)    },
+    { MP_ROM_QSTR(MP_QSTR_wait),        MP_ROM_PTR(&mp_lcd_emulated_panel_wait_obj)        },
+    { MP_ROM_QSTR(MP_QSTR_busy),        MP_ROM_PTR(&mp_lcd_emulated_panel_busy_obj)        },
+    { MP_ROM_QSTR(MP_QSTR_step),        MP_ROM_PTR(&mp_lcd_emulated_panel_step_obj)        },
+    { MP_ROM_QSTR(MP_QSTR_dump_ppm),    MP_ROM_PTR(&mp_lcd_emulated_panel_dump_ppm_obj)    },
+    { MP_ROM_QSTR(MP_QSTR_stats),       MP_ROM_PTR(&mp_lcd_emulated_panel_stats_obj)       },
+    { MP_ROM_QSTR(MP_QSTR_reset_stats), MP_ROM_PTR(&mp_lcd_emulated_panel_reset_stats_obj) },
+    { MP_ROM_QSTR(MP_QSTR_deinit),      MP_ROM_PTR(&mp_lcd_emulated_panel_deinit_obj)      },
+    { MP_ROM_QSTR(MP_QSTR___del__),     MP_ROM_PTR(&mp_lcd_emulated_panel_deinit_obj)      },
+};
+STATIC MP_DEFINE_CONST_DICT(mp_lcd_emulated_panel_locals_dict, mp_lcd_emulated_panel_locals_dict_table);
+
+
+STATIC const mp_lcd_panel_p_t mp_lcd_panel_p = {
+    .tx_param = emulated_panel_tx_param,
+    .tx_color = emulated_panel_tx_color,
+    .tx_pattern = emulated_panel_tx_pattern,
+    .deinit = emulated_panel_deinit,
+    .wait = emulated_panel_wait,
+    .busy = emulated_panel_busy,
+    .notify = emulated_panel_notify
+};
+
+
+#ifdef MP_OBJ_TYPE_GET_SLOT
+MP_DEFINE_CONST_OBJ_TYPE(
+    mp_lcd_emulated_panel_type,
+    MP_QSTR_EmulatedPanel,
+    MP_TYPE_FLAG_NONE,
+    print, mp_lcd_emulated_panel_print,
+    make_new, mp_lcd_emulated_panel_make_new,
+    protocol, &mp_lcd_panel_p,
+    locals_dict, (mp_obj_dict_t *)&mp_lcd_emulated_panel_locals_dict
+);
+#else
+const mp_obj_type_t mp_lcd_emulated_panel_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_EmulatedPanel,
+    .print = mp_lcd_emulated_panel_print,
+    .make_new = mp_lcd_emulated_panel_make_new,
+    .protocol = &mp_lcd_panel_p,
+    .locals_dict = (mp_obj_dict_t *)&mp_lcd_emulated_panel_locals_dict,
+};
+#endif
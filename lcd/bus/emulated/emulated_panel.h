@@ -0,0 +1,59 @@
+#ifndef LCD_EMULATED_PANEL_H_
+#define LCD_EMULATED_PANEL_H_
+
+#include "py/obj.h"
+
+// transactions that may be pending in queued mode, like the QSPI bus
+#define EMULATED_PANEL_QUEUE_DEPTH (10)
+
+// notify() calls that may wait for their transaction at the same time
+#define EMULATED_PANEL_NOTIFY_DEPTH (4)
+
+// a transaction held back in queued mode, with a copy of its data
+typedef struct _emulated_panel_trans_t {
+    uint8_t kind;                   // EMULATED_PANEL_TRANS_*
+    int lcd_cmd;
+    uint8_t *data;                  // NULL for transactions without data
+    size_t data_size;
+    size_t color_size;              // bytes a pattern covers
+} emulated_panel_trans_t;
+
+typedef struct _mp_lcd_emulated_panel_obj_t {
+    mp_obj_base_t base;
+    uint16_t width;                 // native resolution of the emulated panel
+    uint16_t height;
+
+    uint8_t madctl_val;             // last value written to LCD_CMD_MADCTL
+    uint8_t pixel_bytes;            // bytes per pixel selected by LCD_CMD_COLMOD
+    uint16_t x_start;               // GRAM window set by LCD_CMD_CASET/LCD_CMD_RASET
+    uint16_t x_end;
+    uint16_t y_start;
+    uint16_t y_end;
+    uint16_t x;                     // write cursor inside the window
+    uint16_t y;
+    uint16_t tfa;                   // vertical scrolling definition
+    uint16_t vsa;
+    uint16_t bfa;
+    uint16_t vssa;                  // vertical scroll start address
+
+    size_t gram_size;               // GRAM size in bytes, stored as RGB888
+    uint8_t *gram;
+
+    uint32_t param_transactions;
+    uint32_t color_transactions;
+    uint64_t param_bytes;
+    uint64_t color_bytes;
+
+    bool queued;                    // transactions wait for wait(), busy() or step()
+    emulated_panel_trans_t trans[EMULATED_PANEL_QUEUE_DEPTH];
+    uint8_t trans_head;             // oldest pending transaction
+    uint8_t trans_pending;
+    uint32_t trans_seq;             // transactions queued so far
+    uint32_t notify_seq[EMULATED_PANEL_NOTIFY_DEPTH]; // schedule notify_cb[i] once this one is done, 0 if free
+    mp_obj_t notify_cb[EMULATED_PANEL_NOTIFY_DEPTH];
+    mp_obj_t notify_arg[EMULATED_PANEL_NOTIFY_DEPTH];
+} mp_lcd_emulated_panel_obj_t;
+
+extern const mp_obj_type_t mp_lcd_emulated_panel_type;
+
+#endif
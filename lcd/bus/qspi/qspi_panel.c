@@ -20,14 +20,19 @@ STATIC void mp_lcd_qspi_panel_print(const mp_print_t *print,
     mp_lcd_qspi_panel_obj_t *self = MP_OBJ_TO_PTR(self_in);
     mp_printf(
         print,
-        "<QSPI Panel SPI=%p, dc=%p, cs=%p, width=%u, height=%u, cmd_bits=%u, param_bits=%u>",
+        "<QSPI Panel SPI=%p, dc=%p, cs=%p, width=%u, height=%u, cmd_bits=%u, param_bits=%u, bpp=%u, queued=%u, worker=%u, chunk_size=%u, max_transfer_sz=%u>",
         self->spi_obj,
         self->dc,
         self->cs,
         self->width,
         self->height,
         self->cmd_bits,
-        self->param_bits
+        self->param_bits,
+        self->bpp,
+        self->queued,
+        self->worker,
+        self->chunk_size,
+        self->max_transfer_sz
     );
 }
 
@@ -46,7 +51,13 @@ STATIC mp_obj_t mp_lcd_qspi_panel_make_new(const mp_obj_type_t *type,
         ARG_width,
         ARG_height,
         ARG_cmd_bits,
-        ARG_param_bits
+        ARG_param_bits,
+        ARG_queued,
+        ARG_bpp,
+        ARG_chunk_size,
+        ARG_max_transfer_sz,
+        ARG_worker,
+        ARG_dma_pool
     };
     const mp_arg_t make_new_args[] = {
         { MP_QSTR_spi,              MP_ARG_OBJ | MP_ARG_KW_ONLY | MP_ARG_REQUIRED        },
@@ -58,6 +69,12 @@ STATIC mp_obj_t mp_lcd_qspi_panel_make_new(const mp_obj_type_t *type,
         { MP_QSTR_height,           MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 240        } },
         { MP_QSTR_cmd_bits,         MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 8         }  },
         { MP_QSTR_param_bits,       MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 8         }  },
+        { MP_QSTR_queued,           MP_ARG_BOOL | MP_ARG_KW_ONLY, {.u_bool = false    }  },
+        { MP_QSTR_bpp,              MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 16        }  },
+        { MP_QSTR_chunk_size,       MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 0         }  },
+        { MP_QSTR_max_transfer_sz,  MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 0         }  },
+        { MP_QSTR_worker,           MP_ARG_BOOL | MP_ARG_KW_ONLY, {.u_bool = false    }  },
+        { MP_QSTR_dma_pool,         MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = QSPI_PANEL_DMA_POOL_SIZE} },
     };
     mp_arg_val_t args[MP_ARRAY_SIZE(make_new_args)];
     mp_arg_parse_all_kw_array(
@@ -69,7 +86,7 @@ STATIC mp_obj_t mp_lcd_qspi_panel_make_new(const mp_obj_type_t *type,
     );
 
     // create new object
-    mp_lcd_qspi_panel_obj_t *self = m_new_obj(mp_lcd_qspi_panel_obj_t);
+    mp_lcd_qspi_panel_obj_t *self = m_new_obj_with_finaliser(mp_lcd_qspi_panel_obj_t);
     self->base.type = &mp_lcd_qspi_panel_type;
     self->spi_obj          = (mp_obj_base_t *)MP_OBJ_TO_PTR(args[ARG_spi].u_obj);
     // data bus
@@ -86,6 +103,23 @@ STATIC mp_obj_t mp_lcd_qspi_panel_make_new(const mp_obj_type_t *type,
     self->height     = args[ARG_height].u_int;
     self->cmd_bits   = args[ARG_cmd_bits].u_int;
     self->param_bits = args[ARG_param_bits].u_int;
+    self->queued     = args[ARG_queued].u_bool;
+    self->worker     = args[ARG_worker].u_bool;
+    self->bpp        = args[ARG_bpp].u_int;
+    // 0 means worked out by the hal
+    self->chunk_size      = args[ARG_chunk_size].u_int;
+    self->max_transfer_sz = args[ARG_max_transfer_sz].u_int;
+    self->dma_pool_size   = args[ARG_dma_pool].u_int;
+
+    if (self->bpp != 16 && self->bpp != 18 && self->bpp != 24) {
+        mp_raise_ValueError(MP_ERROR_TEXT("unsupported bpp"));
+    }
+    if (self->queued && self->worker) {
+        mp_raise_ValueError(MP_ERROR_TEXT("queued and worker can not be combined"));
+    }
+    if (args[ARG_dma_pool].u_int <= 0 || args[ARG_dma_pool].u_int > QSPI_PANEL_DMA_POOL_MAX_SIZE) {
+        mp_raise_ValueError(MP_ERROR_TEXT("dma_pool must be 1 to 131072 bytes"));
+    }
 
     hal_lcd_qspi_panel_construct(&self->base);
     return MP_OBJ_FROM_PTR(self);
@@ -117,6 +151,7 @@ STATIC mp_obj_t mp_lcd_qspi_panel_tx_color(size_t n_args, const mp_obj_t *args_i
     if (n_args == 3) {
         mp_buffer_info_t bufinfo;
         mp_get_buffer_raise(args_in[2], &bufinfo, MP_BUFFER_READ);
+        hal_lcd_qspi_panel_source(self, args_in[2]);
         hal_lcd_qspi_panel_tx_color(self, cmd, bufinfo.buf, bufinfo.len);
     } else {
         hal_lcd_qspi_panel_tx_color(self, cmd, NULL, 0);
@@ -127,6 +162,116 @@ STATIC mp_obj_t mp_lcd_qspi_panel_tx_color(size_t n_args, const mp_obj_t *args_i
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_qspi_panel_tx_color_obj, 2, 3, mp_lcd_qspi_panel_tx_color);
 
 
+STATIC mp_obj_t mp_lcd_qspi_panel_wait(mp_obj_t self_in)
+{
+    mp_obj_base_t *self = (mp_obj_base_t *)MP_OBJ_TO_PTR(self_in);
+
+    hal_lcd_qspi_panel_wait(self);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_qspi_panel_wait_obj, mp_lcd_qspi_panel_wait);
+
+
+STATIC mp_obj_t mp_lcd_qspi_panel_busy(mp_obj_t self_in)
+{
+    mp_obj_base_t *self = (mp_obj_base_t *)MP_OBJ_TO_PTR(self_in);
+
+    return mp_obj_new_bool(hal_lcd_qspi_panel_busy(self));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_qspi_panel_busy_obj, mp_lcd_qspi_panel_busy);
+
+
+// Time sending nbytes (a full frame by default) in chunks of chunk_size.
+// Returns (total_us, chunks, overhead_us) where overhead_us is the time per
+// chunk not spent clocking out data.
+STATIC mp_obj_t mp_lcd_qspi_panel_measure(size_t n_args, const mp_obj_t *args_in)
+{
+    mp_lcd_qspi_panel_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    uint32_t chunk_size = mp_obj_get_int(args_in[1]);
+    mp_int_t nbytes = self->width * self->height * (self->bpp == 16 ? 2 : 3);
+    if (n_args == 3) {
+        nbytes = mp_obj_get_int(args_in[2]);
+    }
+    if (nbytes <= 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("nbytes must be positive"));
+    }
+
+    int64_t total_us = hal_lcd_qspi_panel_measure(&self->base, chunk_size, nbytes);
+    size_t chunks = (nbytes + chunk_size - 1) / chunk_size;
+    // four data lines, one bit each per clock
+    float wire_us = (float)nbytes * 2 * 1000000 / self->pclk;
+
+    mp_obj_t tuple[3] = {
+        mp_obj_new_int(total_us),
+        mp_obj_new_int(chunks),
+        mp_obj_new_float(chunks ? (total_us - wire_us) / chunks : 0),
+    };
+    return mp_obj_new_tuple(3, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_qspi_panel_measure_obj, 2, 3, mp_lcd_qspi_panel_measure);
+
+
+// Returns a buffer from the dma pool, bitmap() sends it without a copy.
+// The first call reserves the pool with the dma_pool size of this bus.
+STATIC mp_obj_t mp_lcd_qspi_panel_alloc_buffer(mp_obj_t self_in, mp_obj_t size_in)
+{
+    mp_lcd_qspi_panel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    size_t len = mp_obj_get_int(size_in);
+
+    mp_lcd_dma_buffer_obj_t *o = m_new_obj_with_finaliser(mp_lcd_dma_buffer_obj_t);
+    o->base.type = &mp_lcd_dma_buffer_type;
+    o->buf = NULL;
+    o->len = len;
+    o->panel = NULL;
+    o->seq = 0;
+    o->buf = hal_lcd_dma_alloc(&o->base, len, self->dma_pool_size);
+    if (o->buf == NULL) {
+        mp_raise_msg(&mp_type_MemoryError, MP_ERROR_TEXT("DMA pool exhausted"));
+    }
+    return MP_OBJ_FROM_PTR(o);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mp_lcd_qspi_panel_alloc_buffer_obj, mp_lcd_qspi_panel_alloc_buffer);
+
+
+STATIC mp_obj_t mp_lcd_qspi_panel_stats(mp_obj_t self_in)
+{
+    mp_lcd_qspi_panel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    qspi_panel_stats_t *st = &self->stats;
+
+    mp_obj_t latency = mp_obj_new_dict(3);
+    mp_obj_dict_store(latency, MP_OBJ_NEW_QSTR(MP_QSTR_tx_param), lcd_stats_hist_dict(&st->tx_param_us));
+    mp_obj_dict_store(latency, MP_OBJ_NEW_QSTR(MP_QSTR_tx_color), lcd_stats_hist_dict(&st->tx_color_us));
+    mp_obj_dict_store(latency, MP_OBJ_NEW_QSTR(MP_QSTR_tx_pattern), lcd_stats_hist_dict(&st->tx_pattern_us));
+
+    mp_obj_t stats = mp_obj_new_dict(11);
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_transactions),
+        mp_obj_new_int_from_uint(st->param_transactions + st->color_transactions));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_bytes),
+        mp_obj_new_int_from_ull(st->param_bytes + st->color_bytes));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_tx_param), mp_obj_new_int_from_uint(st->param_transactions));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_tx_color), mp_obj_new_int_from_uint(st->color_transactions));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_param_bytes), mp_obj_new_int_from_ull(st->param_bytes));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_color_bytes), mp_obj_new_int_from_ull(st->color_bytes));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_chunks), mp_obj_new_int_from_uint(st->chunks));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_cs_toggles), mp_obj_new_int_from_uint(st->cs_toggles));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_blocked_us), mp_obj_new_int_from_ull(st->blocked_us));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_staged_bytes), mp_obj_new_int_from_ull(st->staged_bytes));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_latency), latency);
+    return stats;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_qspi_panel_stats_obj, mp_lcd_qspi_panel_stats);
+
+
+STATIC mp_obj_t mp_lcd_qspi_panel_reset_stats(mp_obj_t self_in)
+{
+    mp_lcd_qspi_panel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    memset(&self->stats, 0, sizeof(self->stats));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_qspi_panel_reset_stats_obj, mp_lcd_qspi_panel_reset_stats);
+
+
 STATIC mp_obj_t mp_lcd_qspi_panel_deinit(mp_obj_t self_in)
 {
     mp_obj_base_t *self = (mp_obj_base_t *)MP_OBJ_TO_PTR(self_in);
@@ -141,6 +286,12 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_qspi_panel_deinit_obj, mp_lcd_qspi_panel
 STATIC const mp_rom_map_elem_t mp_lcd_qspi_panel_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_tx_param), MP_ROM_PTR(&mp_lcd_qspi_panel_tx_param_obj) },
     { MP_ROM_QSTR(MP_QSTR_tx_color), MP_ROM_PTR(&mp_lcd_qspi_panel_tx_color_obj) },
+    { MP_ROM_QSTR(MP_QSTR_wait),     MP_ROM_PTR(&mp_lcd_qspi_panel_wait_obj)     },
+    { MP_ROM_QSTR(MP_QSTR_busy),     MP_ROM_PTR(&mp_lcd_qspi_panel_busy_obj)     },
+    { MP_ROM_QSTR(MP_QSTR_alloc_buffer), MP_ROM_PTR(&mp_lcd_qspi_panel_alloc_buffer_obj) },
+    { MP_ROM_QSTR(MP_QSTR_measure),  MP_ROM_PTR(&mp_lcd_qspi_panel_measure_obj)  },
+    { MP_ROM_QSTR(MP_QSTR_stats),    MP_ROM_PTR(&mp_lcd_qspi_panel_stats_obj)    },
+    { MP_ROM_QSTR(MP_QSTR_reset_stats), MP_ROM_PTR(&mp_lcd_qspi_panel_reset_stats_obj) },
     { MP_ROM_QSTR(MP_QSTR_deinit),   MP_ROM_PTR(&mp_lcd_qspi_panel_deinit_obj)   },
     { MP_ROM_QSTR(MP_QSTR___del__),  MP_ROM_PTR(&mp_lcd_qspi_panel_deinit_obj)   },
 };
@@ -150,7 +301,12 @@ STATIC MP_DEFINE_CONST_DICT(mp_lcd_qspi_panel_locals_dict, mp_lcd_qspi_panel_loc
 STATIC const mp_lcd_panel_p_t mp_lcd_panel_p = {
     .tx_param = hal_lcd_qspi_panel_tx_param,
     .tx_color = hal_lcd_qspi_panel_tx_color,
-    .deinit = hal_lcd_qspi_panel_deinit
+    .tx_pattern = hal_lcd_qspi_panel_tx_pattern,
+    .deinit = hal_lcd_qspi_panel_deinit,
+    .wait = hal_lcd_qspi_panel_wait,
+    .busy = hal_lcd_qspi_panel_busy,
+    .notify = hal_lcd_qspi_panel_notify,
+    .source = hal_lcd_qspi_panel_source
 };
 
 
@@ -174,3 +330,72 @@ const mp_obj_type_t mp_lcd_qspi_panel_type = {
     .locals_dict = (mp_obj_dict_t *)&mp_lcd_qspi_panel_locals_dict,
 };
 #endif
+
+
+STATIC mp_int_t mp_lcd_dma_buffer_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags)
+{
+    mp_lcd_dma_buffer_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    if (self->buf == NULL) {
+        return 1;
+    }
+    bufinfo->buf = self->buf;
+    bufinfo->len = self->len;
+    bufinfo->typecode = 'B';
+    return 0;
+}
+
+
+STATIC mp_obj_t mp_lcd_dma_buffer_unary_op(mp_unary_op_t op, mp_obj_t self_in)
+{
+    mp_lcd_dma_buffer_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    switch (op) {
+        case MP_UNARY_OP_LEN:
+            return MP_OBJ_NEW_SMALL_INT(self->buf ? self->len : 0);
+        default:
+            return MP_OBJ_NULL;
+    }
+}
+
+
+// Give the blocks back to the pool, the buffer can not be used afterwards.
+// Waits for a queued transfer still reading it. While one is queued the bus
+// keeps the buffer reachable, so the finaliser only runs once it is done.
+STATIC mp_obj_t mp_lcd_dma_buffer_free(mp_obj_t self_in)
+{
+    mp_lcd_dma_buffer_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    hal_lcd_dma_free(self->buf);
+    self->buf = NULL;
+    self->panel = NULL;
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_dma_buffer_free_obj, mp_lcd_dma_buffer_free);
+
+
+STATIC const mp_rom_map_elem_t mp_lcd_dma_buffer_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_free),    MP_ROM_PTR(&mp_lcd_dma_buffer_free_obj) },
+    { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&mp_lcd_dma_buffer_free_obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(mp_lcd_dma_buffer_locals_dict, mp_lcd_dma_buffer_locals_dict_table);
+
+
+#ifdef MP_OBJ_TYPE_GET_SLOT
+MP_DEFINE_CONST_OBJ_TYPE(
+    mp_lcd_dma_buffer_type,
+    MP_QSTR_DMABuffer,
+    MP_TYPE_FLAG_NONE,
+    unary_op, mp_lcd_dma_buffer_unary_op,
+    buffer, mp_lcd_dma_buffer_get_buffer,
+    locals_dict, (mp_obj_dict_t *)&mp_lcd_dma_buffer_locals_dict
+);
+#else
+const mp_obj_type_t mp_lcd_dma_buffer_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_DMABuffer,
+    .unary_op = mp_lcd_dma_buffer_unary_op,
+    .buffer_p = { .get_buffer = mp_lcd_dma_buffer_get_buffer },
+    .locals_dict = (mp_obj_dict_t *)&mp_lcd_dma_buffer_locals_dict,
+};
+#endif
@@ -3,10 +3,55 @@
 
 #include "mphalport.h"
 #include "py/obj.h"
+#include "lcd_panel_stats.h"
 #if USE_ESP_LCD
+#include "lcd_spsc.h"
 #include "esp_lcd_panel_io.h"
 #include "driver/spi_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+// number of transactions that may be in flight in queued mode,
+// also used as the queue_size of the spi device.
+#define QSPI_PANEL_QUEUE_DEPTH (10)
+
+// transactions handed to the flush worker on the other core, a power of two
+#define QSPI_PANEL_WORKER_DEPTH (16)
+
+// staging buffers for sources the dma can not read directly (psram, flash,
+// unaligned), allocated from dma capable ram per bus.
+#define QSPI_PANEL_BOUNCE_BUFFERS (2)
+#define QSPI_PANEL_BOUNCE_SIZE    (4096)
+
+// notify() calls that may wait for their transaction at the same time
+#define QSPI_PANEL_NOTIFY_DEPTH (4)
+
+// bytes of internal ram the first alloc_buffer() reserves for the dma pool,
+// unless the bus was given dma_pool=. Up to 32 blocks of 4 KB.
+#ifndef QSPI_PANEL_DMA_POOL_SIZE
+#define QSPI_PANEL_DMA_POOL_SIZE (64 * 1024)
 #endif
+#define QSPI_PANEL_DMA_POOL_MAX_SIZE (128 * 1024)
+
+// a single spi transaction can not move more than this
+#define QSPI_PANEL_MAX_CHUNK_SIZE (0x8000)
+#endif
+
+// what the bus did since it was created or stats were reset
+typedef struct _qspi_panel_stats_t {
+    uint32_t param_transactions; // tx_param calls
+    uint32_t color_transactions; // tx_color and tx_pattern calls
+    uint64_t param_bytes;
+    uint64_t color_bytes;
+    uint32_t chunks;             // spi transactions carrying pixel data
+    uint32_t cs_toggles;         // times cs was asserted
+    uint64_t blocked_us;         // time spent waiting for the spi driver
+    uint64_t staged_bytes;       // bytes copied through the bounce buffers
+    lcd_stats_hist_t tx_param_us; // latency of the calls, until they return
+    lcd_stats_hist_t tx_color_us;
+    lcd_stats_hist_t tx_pattern_us;
+} qspi_panel_stats_t;
 
 typedef struct _mp_lcd_qspi_panel_obj_t {
     mp_obj_base_t base;
@@ -25,14 +70,55 @@ typedef struct _mp_lcd_qspi_panel_obj_t {
     uint32_t pclk;
     int cmd_bits;
     int param_bits;
+    uint8_t bpp;
+    uint32_t chunk_size;      // pixel data is split into transactions of this size
+    uint32_t max_transfer_sz; // largest transaction the spi bus is set up for
+    size_t dma_pool_size;     // bytes the dma pool is reserved with by the first alloc_buffer()
     // bool swap_color_bytes;
+    bool queued;
+    bool worker;              // transactions are sent by a task on the other core
+    qspi_panel_stats_t stats;
 #if USE_ESP_LCD
     spi_device_handle_t io_handle;
+    // ring of queued transactions
+    spi_transaction_ext_t trans[QSPI_PANEL_WORKER_DEPTH];
+    mp_obj_t trans_owner[QSPI_PANEL_WORKER_DEPTH];    // object holding the data trans[i] reads, MP_OBJ_NULL if none
+    mp_obj_t tx_source;                              // holds the data of the next tx_color or tx_pattern
+    uint8_t trans_head;
+    uint8_t trans_inflight;
+    uint32_t trans_seq;                              // transactions queued so far
+    uint8_t *bounce[QSPI_PANEL_BOUNCE_BUFFERS];
+    uint32_t bounce_seq[QSPI_PANEL_BOUNCE_BUFFERS]; // last transaction reading the bounce buffer
+    uint8_t bounce_next;
+    lcd_spsc_t worker_queue;                         // slots of trans[] owned by the worker
+    atomic_uint_fast32_t trans_done;                 // queued transactions the spi driver finished
+    uint32_t trans_queued_us[QSPI_PANEL_WORKER_DEPTH]; // when the slot was handed over, for the tracer
+    uint32_t trans_end_us[QSPI_PANEL_WORKER_DEPTH];    // when it was done, set by post_cb or the worker
+    uint32_t trace_seq;                              // transactions the tracer recorded so far
+    uint8_t trace_slot;                              // slot of the next one
+    uint32_t trace_end_us;                           // when the last recorded one was done
+    atomic_uint_fast32_t notify_seq[QSPI_PANEL_NOTIFY_DEPTH]; // schedule notify_cb[i] once this one is done, 0 if free
+    mp_obj_t notify_cb[QSPI_PANEL_NOTIFY_DEPTH];
+    mp_obj_t notify_arg[QSPI_PANEL_NOTIFY_DEPTH];
+    TaskHandle_t worker_task;
+    SemaphoreHandle_t worker_popped;                 // given by the worker after every transaction
+    atomic_bool worker_stop;                         // set to end the worker
+    atomic_bool worker_done;                         // set by the worker when it ends
 #else
     void (*write_color)(mp_hal_pin_obj_t *databus, mp_hal_pin_obj_t wr, const uint8_t *buf, int len);
 #endif
 } mp_lcd_qspi_panel_obj_t;
 
+typedef struct _mp_lcd_dma_buffer_obj_t {
+    mp_obj_base_t base;
+    void *buf;
+    size_t len;
+    mp_obj_base_t *panel;     // bus of the last transaction reading the buffer, NULL if none
+    uint32_t seq;             // that transaction, free() waits for it
+} mp_lcd_dma_buffer_obj_t;
+
 extern const mp_obj_type_t mp_lcd_qspi_panel_type;
 
+extern const mp_obj_type_t mp_lcd_dma_buffer_type;
+
 #endif
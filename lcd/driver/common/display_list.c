@@ -0,0 +1,220 @@
+#include "display_list.h"
+#include "lcd_panel_convert.h"
+
+#include "py/obj.h"
+#include "py/runtime.h"
+
+#include <string.h>
+
+
+STATIC const uint8_t display_list_arg_count[] = {
+    [DISPLAY_LIST_OP_FILL]        = 1,
+    [DISPLAY_LIST_OP_PIXEL]       = 3,
+    [DISPLAY_LIST_OP_HLINE]       = 4,
+    [DISPLAY_LIST_OP_VLINE]       = 4,
+    [DISPLAY_LIST_OP_FILL_RECT]   = 5,
+    [DISPLAY_LIST_OP_RECT]        = 5,
+    [DISPLAY_LIST_OP_FILL_CIRCLE] = 4,
+    [DISPLAY_LIST_OP_CIRCLE]      = 4,
+    [DISPLAY_LIST_OP_BITMAP]      = 6,
+};
+
+
+size_t display_list_args(uint8_t op) {
+    if (op >= MP_ARRAY_SIZE(display_list_arg_count)) {
+        return 0;
+    }
+    return display_list_arg_count[op];
+}
+
+
+STATIC void display_list_emit(mp_lcd_display_list_obj_t *self, uint8_t op, const int16_t *args) {
+    size_t n = 1 + display_list_args(op) * sizeof(int16_t);
+    if (self->len + n > self->alloc) {
+        size_t alloc = self->alloc ? self->alloc * 2 : 64;
+        self->code = m_renew(uint8_t, self->code, self->alloc, alloc);
+        self->alloc = alloc;
+    }
+    self->code[self->len] = op;
+    memcpy(self->code + self->len + 1, args, n - 1);
+    self->len += n;
+}
+
+
+// record op with the integer arguments of a call, args_in[0] is self
+STATIC mp_obj_t display_list_record(uint8_t op, size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_display_list_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    int16_t args[DISPLAY_LIST_MAX_ARGS];
+    for (size_t i = 1; i < n_args; i++) {
+        args[i - 1] = mp_obj_get_int(args_in[i]);
+    }
+    display_list_emit(self, op, args);
+    return mp_const_none;
+}
+
+
+STATIC void mp_lcd_display_list_print(const mp_print_t *print,
+                                      mp_obj_t          self_in,
+                                      mp_print_kind_t   kind)
+{
+    (void) kind;
+    mp_lcd_display_list_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_printf(print, "<DisplayList bytes=%u>", (unsigned)self->len);
+}
+
+
+STATIC mp_obj_t mp_lcd_display_list_make_new(const mp_obj_type_t *type,
+                                             size_t               n_args,
+                                             size_t               n_kw,
+                                             const mp_obj_t      *all_args)
+{
+    mp_arg_check_num(n_args, n_kw, 0, 0, false);
+
+    mp_lcd_display_list_obj_t *self = m_new_obj(mp_lcd_display_list_obj_t);
+    self->base.type = type;
+    self->code = NULL;
+    self->len = 0;
+    self->alloc = 0;
+    self->bufs = mp_obj_new_list(0, NULL);
+    return MP_OBJ_FROM_PTR(self);
+}
+
+
+STATIC mp_obj_t mp_lcd_display_list_fill(mp_obj_t self_in, mp_obj_t color_in) {
+    mp_obj_t args[] = { self_in, color_in };
+    return display_list_record(DISPLAY_LIST_OP_FILL, 2, args);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mp_lcd_display_list_fill_obj, mp_lcd_display_list_fill);
+
+
+STATIC mp_obj_t mp_lcd_display_list_pixel(size_t n_args, const mp_obj_t *args_in) {
+    return display_list_record(DISPLAY_LIST_OP_PIXEL, n_args, args_in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_display_list_pixel_obj, 4, 4, mp_lcd_display_list_pixel);
+
+
+STATIC mp_obj_t mp_lcd_display_list_hline(size_t n_args, const mp_obj_t *args_in) {
+    return display_list_record(DISPLAY_LIST_OP_HLINE, n_args, args_in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_display_list_hline_obj, 5, 5, mp_lcd_display_list_hline);
+
+
+STATIC mp_obj_t mp_lcd_display_list_vline(size_t n_args, const mp_obj_t *args_in) {
+    return display_list_record(DISPLAY_LIST_OP_VLINE, n_args, args_in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_display_list_vline_obj, 5, 5, mp_lcd_display_list_vline);
+
+
+STATIC mp_obj_t mp_lcd_display_list_fill_rect(size_t n_args, const mp_obj_t *args_in) {
+    return display_list_record(DISPLAY_LIST_OP_FILL_RECT, n_args, args_in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_display_list_fill_rect_obj, 6, 6, mp_lcd_display_list_fill_rect);
+
+
+STATIC mp_obj_t mp_lcd_display_list_rect(size_t n_args, const mp_obj_t *args_in) {
+    return display_list_record(DISPLAY_LIST_OP_RECT, n_args, args_in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_display_list_rect_obj, 6, 6, mp_lcd_display_list_rect);
+
+
+STATIC mp_obj_t mp_lcd_display_list_fill_circle(size_t n_args, const mp_obj_t *args_in) {
+    return display_list_record(DISPLAY_LIST_OP_FILL_CIRCLE, n_args, args_in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_display_list_fill_circle_obj, 5, 5, mp_lcd_display_list_fill_circle);
+
+
+STATIC mp_obj_t mp_lcd_display_list_circle(size_t n_args, const mp_obj_t *args_in) {
+    return display_list_record(DISPLAY_LIST_OP_CIRCLE, n_args, args_in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_display_list_circle_obj, 5, 5, mp_lcd_display_list_circle);
+
+
+// The buffer is referenced, not copied, so changing its content changes
+// what the next replay draws.
+STATIC mp_obj_t mp_lcd_display_list_bitmap(size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_display_list_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    int x_start = mp_obj_get_int(args_in[1]);
+    int y_start = mp_obj_get_int(args_in[2]);
+    int x_end = mp_obj_get_int(args_in[3]);
+    int y_end = mp_obj_get_int(args_in[4]);
+    int format = (n_args > 6) ? mp_obj_get_int(args_in[6]) : -1;
+
+    if (format != -1 && format != PIXEL_FORMAT_RGB565 && format != PIXEL_FORMAT_RGB565_SWAPPED) {
+        mp_raise_ValueError(MP_ERROR_TEXT("unsupported format"));
+    }
+    if (x_end <= x_start || y_end <= y_start) {
+        return mp_const_none;
+    }
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args_in[5], &bufinfo, MP_BUFFER_READ);
+    if ((size_t)(x_end - x_start) * (y_end - y_start) * 2 > bufinfo.len) {
+        mp_raise_ValueError(MP_ERROR_TEXT("buffer too small"));
+    }
+
+    size_t index;
+    mp_obj_t *bufs;
+    mp_obj_list_get(self->bufs, &index, &bufs);
+    mp_obj_list_append(self->bufs, args_in[5]);
+
+    int16_t args[] = { x_start, y_start, x_end - x_start, y_end - y_start, format, index };
+    display_list_emit(self, DISPLAY_LIST_OP_BITMAP, args);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_display_list_bitmap_obj, 6, 7, mp_lcd_display_list_bitmap);
+
+
+STATIC mp_obj_t mp_lcd_display_list_clear(mp_obj_t self_in) {
+    mp_lcd_display_list_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    self->len = 0;
+    self->bufs = mp_obj_new_list(0, NULL);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_display_list_clear_obj, mp_lcd_display_list_clear);
+
+
+STATIC mp_obj_t mp_lcd_display_list_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+    mp_lcd_display_list_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    switch (op) {
+        case MP_UNARY_OP_LEN:
+            return MP_OBJ_NEW_SMALL_INT(self->len);
+        default:
+            return MP_OBJ_NULL;
+    }
+}
+
+
+STATIC const mp_rom_map_elem_t mp_lcd_display_list_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_fill),        MP_ROM_PTR(&mp_lcd_display_list_fill_obj)        },
+    { MP_ROM_QSTR(MP_QSTR_pixel),       MP_ROM_PTR(&mp_lcd_display_list_pixel_obj)       },
+    { MP_ROM_QSTR(MP_QSTR_hline),       MP_ROM_PTR(&mp_lcd_display_list_hline_obj)       },
+    { MP_ROM_QSTR(MP_QSTR_vline),       MP_ROM_PTR(&mp_lcd_display_list_vline_obj)       },
+    { MP_ROM_QSTR(MP_QSTR_fill_rect),   MP_ROM_PTR(&mp_lcd_display_list_fill_rect_obj)   },
+    { MP_ROM_QSTR(MP_QSTR_rect),        MP_ROM_PTR(&mp_lcd_display_list_rect_obj)        },
+    { MP_ROM_QSTR(MP_QSTR_fill_circle), MP_ROM_PTR(&mp_lcd_display_list_fill_circle_obj) },
+    { MP_ROM_QSTR(MP_QSTR_circle),      MP_ROM_PTR(&mp_lcd_display_list_circle_obj)      },
+    { MP_ROM_QSTR(MP_QSTR_bitmap),      MP_ROM_PTR(&mp_lcd_display_list_bitmap_obj)      },
+    { MP_ROM_QSTR(MP_QSTR_clear),       MP_ROM_PTR(&mp_lcd_display_list_clear_obj)       },
+};
+STATIC MP_DEFINE_CONST_DICT(mp_lcd_display_list_locals_dict, mp_lcd_display_list_locals_dict_table);
+
+
+#ifdef MP_OBJ_TYPE_GET_SLOT
+MP_DEFINE_CONST_OBJ_TYPE(
+    mp_lcd_display_list_type,
+    MP_QSTR_DisplayList,
+    MP_TYPE_FLAG_NONE,
+    print, mp_lcd_display_list_print,
+    make_new, mp_lcd_display_list_make_new,
+    unary_op, mp_lcd_display_list_unary_op,
+    locals_dict, (mp_obj_dict_t *)&mp_lcd_display_list_locals_dict
+);
+#else
+const mp_obj_type_t mp_lcd_display_list_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_DisplayList,
+    .print = mp_lcd_display_list_print,
+    .make_new = mp_lcd_display_list_make_new,
+    .unary_op = mp_lcd_display_list_unary_op,
+    .locals_dict = (mp_obj_dict_t *)&mp_lcd_display_list_locals_dict,
+};
+#endif
@@ -0,0 +1,35 @@
+#ifndef _DISPLAY_LIST_H_
+#define _DISPLAY_LIST_H_
+
+#include "py/obj.h"
+
+#include <stdint.h>
+
+// Every operation is one opcode byte followed by its arguments as int16
+// values in native byte order. Colors are stored as they were given.
+#define DISPLAY_LIST_OP_FILL        (1) // color
+#define DISPLAY_LIST_OP_PIXEL       (2) // x, y, color
+#define DISPLAY_LIST_OP_HLINE       (3) // x, y, l, color
+#define DISPLAY_LIST_OP_VLINE       (4) // x, y, l, color
+#define DISPLAY_LIST_OP_FILL_RECT   (5) // x, y, w, h, color
+#define DISPLAY_LIST_OP_RECT        (6) // x, y, w, h, color
+#define DISPLAY_LIST_OP_FILL_CIRCLE (7) // x, y, r, color
+#define DISPLAY_LIST_OP_CIRCLE      (8) // x, y, r, color
+#define DISPLAY_LIST_OP_BITMAP      (9) // x, y, w, h, format, index into bufs
+
+#define DISPLAY_LIST_MAX_ARGS (6)
+
+typedef struct _mp_lcd_display_list_obj_t {
+    mp_obj_base_t base;
+    uint8_t *code;      // recorded operations
+    size_t len;         // bytes used in code
+    size_t alloc;       // bytes allocated for code
+    mp_obj_t bufs;      // list of the buffers bitmap() referenced
+} mp_lcd_display_list_obj_t;
+
+extern const mp_obj_type_t mp_lcd_display_list_type;
+
+// number of int16 arguments following the opcode, 0 for an unknown opcode
+size_t display_list_args(uint8_t op);
+
+#endif
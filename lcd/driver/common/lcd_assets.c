@@ -0,0 +1,290 @@
+#include "lcd_assets.h"
+#include "lcd_font.h"
+
+#include "py/obj.h"
+#include "py/runtime.h"
+
+#include <string.h>
+
+#if !USE_ESP_LCD
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+STATIC uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+STATIC void assets_map(mp_lcd_assets_obj_t *self, const char *source) {
+#if USE_ESP_LCD
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, source);
+    if (part == NULL) {
+        mp_raise_ValueError(MP_ERROR_TEXT("no such partition"));
+    }
+    const void *ptr;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &ptr, &self->handle);
+    if (err != ESP_OK) {
+        mp_raise_msg_varg(&mp_type_OSError, MP_ERROR_TEXT("esp_partition_mmap failed (%d)"), err);
+    }
+    self->data = ptr;
+    self->size = part->size;
+#else
+    int fd = open(source, O_RDONLY);
+    if (fd < 0) {
+        mp_raise_OSError(errno);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        mp_raise_ValueError(MP_ERROR_TEXT("empty asset file"));
+    }
+    // the mapping stays valid after the file is closed
+    void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        mp_raise_OSError(errno);
+    }
+    self->data = ptr;
+    self->size = st.st_size;
+#endif
+}
+
+
+STATIC void assets_unmap(mp_lcd_assets_obj_t *self) {
+    // cached glyphs of packed fonts are keyed by their address in the mapping
+    lcd_glyph_cache_invalidate();
+#if USE_ESP_LCD
+    esp_partition_munmap(self->handle);
+#else
+    munmap((void *)self->data, self->size);
+#endif
+    self->data = NULL;
+    self->size = 0;
+    self->count = 0;
+}
+
+
+STATIC mp_lcd_assets_obj_t *assets_get(mp_obj_t self_in) {
+    mp_lcd_assets_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->data == NULL) {
+        mp_raise_ValueError(MP_ERROR_TEXT("assets closed"));
+    }
+    return self;
+}
+
+
+// directory entry of name, NULL if there is none
+STATIC const uint8_t *assets_find(mp_lcd_assets_obj_t *self, mp_obj_t name_in) {
+    size_t len;
+    const char *name = mp_obj_str_get_data(name_in, &len);
+    if (len > LCD_ASSETS_NAME_LEN) {
+        return NULL;
+    }
+    const uint8_t *entry = self->data + 8;
+    for (uint32_t i = 0; i < self->count; i++, entry += LCD_ASSETS_ENTRY_SIZE) {
+        if (memcmp(entry, name, len) == 0 && (len == LCD_ASSETS_NAME_LEN || entry[len] == 0)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+
+STATIC void mp_lcd_assets_print(const mp_print_t *print,
+                                mp_obj_t          self_in,
+                                mp_print_kind_t   kind)
+{
+    (void) kind;
+    mp_lcd_assets_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_printf(print, "<Assets entries=%u size=%u>", (unsigned)self->count, (unsigned)self->size);
+}
+
+
+STATIC mp_obj_t mp_lcd_assets_make_new(const mp_obj_type_t *type,
+                                       size_t               n_args,
+                                       size_t               n_kw,
+                                       const mp_obj_t      *all_args)
+{
+    mp_arg_check_num(n_args, n_kw, 1, 1, false);
+
+    mp_lcd_assets_obj_t *self = m_new_obj_with_finaliser(mp_lcd_assets_obj_t);
+    self->base.type = type;
+    self->data = NULL;
+    self->count = 0;
+    assets_map(self, mp_obj_str_get_str(all_args[0]));
+
+    if (self->size < 8 || memcmp(self->data, LCD_ASSETS_MAGIC, 4) != 0) {
+        assets_unmap(self);
+        mp_raise_ValueError(MP_ERROR_TEXT("not an asset image"));
+    }
+    uint32_t count = get_u32(self->data + 4);
+    if (count > (self->size - 8) / LCD_ASSETS_ENTRY_SIZE) {
+        assets_unmap(self);
+        mp_raise_ValueError(MP_ERROR_TEXT("asset image truncated"));
+    }
+    self->count = count;
+    return MP_OBJ_FROM_PTR(self);
+}
+
+
+// assets[name] is a read only buffer of the entry in place
+STATIC mp_obj_t mp_lcd_assets_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value) {
+    if (value != MP_OBJ_SENTINEL) {
+        return MP_OBJ_NULL;
+    }
+    mp_lcd_assets_obj_t *self = assets_get(self_in);
+    const uint8_t *entry = assets_find(self, index);
+    if (entry == NULL) {
+        mp_raise_type_arg(&mp_type_KeyError, index);
+    }
+    uint32_t offset = get_u32(entry + LCD_ASSETS_NAME_LEN);
+    uint32_t size = get_u32(entry + LCD_ASSETS_NAME_LEN + 4);
+    if (offset > self->size || size > self->size - offset) {
+        mp_raise_ValueError(MP_ERROR_TEXT("asset image truncated"));
+    }
+    mp_lcd_asset_entry_obj_t *entry_obj = m_new_obj(mp_lcd_asset_entry_obj_t);
+    entry_obj->base.type = &mp_lcd_asset_entry_type;
+    entry_obj->assets = self_in;
+    entry_obj->offset = offset;
+    entry_obj->size = size;
+    return MP_OBJ_FROM_PTR(entry_obj);
+}
+
+
+STATIC mp_obj_t mp_lcd_assets_binary_op(mp_binary_op_t op, mp_obj_t lhs_in, mp_obj_t rhs_in) {
+    switch (op) {
+        case MP_BINARY_OP_CONTAINS:
+            return mp_obj_new_bool(assets_find(assets_get(lhs_in), rhs_in) != NULL);
+        default:
+            return MP_OBJ_NULL;
+    }
+}
+
+
+STATIC mp_obj_t mp_lcd_assets_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+    mp_lcd_assets_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    switch (op) {
+        case MP_UNARY_OP_LEN:
+            return MP_OBJ_NEW_SMALL_INT(self->count);
+        default:
+            return MP_OBJ_NULL;
+    }
+}
+
+
+STATIC mp_obj_t mp_lcd_assets_names(mp_obj_t self_in) {
+    mp_lcd_assets_obj_t *self = assets_get(self_in);
+    mp_obj_t names = mp_obj_new_list(0, NULL);
+    const uint8_t *entry = self->data + 8;
+    for (uint32_t i = 0; i < self->count; i++, entry += LCD_ASSETS_ENTRY_SIZE) {
+        const char *name = (const char *)entry;
+        mp_obj_list_append(names, mp_obj_new_str(name, strnlen(name, LCD_ASSETS_NAME_LEN)));
+    }
+    return names;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_assets_names_obj, mp_lcd_assets_names);
+
+
+// Entries returned before are no buffers anymore, views of them must not be used.
+STATIC mp_obj_t mp_lcd_assets_deinit(mp_obj_t self_in) {
+    mp_lcd_assets_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->data) {
+        assets_unmap(self);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_assets_deinit_obj, mp_lcd_assets_deinit);
+
+
+STATIC const mp_rom_map_elem_t mp_lcd_assets_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_names),   MP_ROM_PTR(&mp_lcd_assets_names_obj)  },
+    { MP_ROM_QSTR(MP_QSTR_deinit),  MP_ROM_PTR(&mp_lcd_assets_deinit_obj) },
+    { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&mp_lcd_assets_deinit_obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(mp_lcd_assets_locals_dict, mp_lcd_assets_locals_dict_table);
+
+
+#ifdef MP_OBJ_TYPE_GET_SLOT
+MP_DEFINE_CONST_OBJ_TYPE(
+    mp_lcd_assets_type,
+    MP_QSTR_Assets,
+    MP_TYPE_FLAG_NONE,
+    print, mp_lcd_assets_print,
+    make_new, mp_lcd_assets_make_new,
+    subscr, mp_lcd_assets_subscr,
+    binary_op, mp_lcd_assets_binary_op,
+    unary_op, mp_lcd_assets_unary_op,
+    locals_dict, (mp_obj_dict_t *)&mp_lcd_assets_locals_dict
+);
+#else
+const mp_obj_type_t mp_lcd_assets_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Assets,
+    .print = mp_lcd_assets_print,
+    .make_new = mp_lcd_assets_make_new,
+    .subscr = mp_lcd_assets_subscr,
+    .binary_op = mp_lcd_assets_binary_op,
+    .unary_op = mp_lcd_assets_unary_op,
+    .locals_dict = (mp_obj_dict_t *)&mp_lcd_assets_locals_dict,
+};
+#endif
+
+
+STATIC void mp_lcd_asset_entry_print(const mp_print_t *print,
+                                     mp_obj_t          self_in,
+                                     mp_print_kind_t   kind)
+{
+    (void) kind;
+    mp_lcd_asset_entry_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_printf(print, "<AssetEntry size=%u>", (unsigned)self->size);
+}
+
+
+STATIC mp_obj_t mp_lcd_asset_entry_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+    mp_lcd_asset_entry_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    switch (op) {
+        case MP_UNARY_OP_LEN:
+            return MP_OBJ_NEW_SMALL_INT(self->size);
+        default:
+            return MP_OBJ_NULL;
+    }
+}
+
+
+STATIC mp_int_t mp_lcd_asset_entry_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags) {
+    mp_lcd_asset_entry_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_lcd_assets_obj_t *assets = MP_OBJ_TO_PTR(self->assets);
+
+    if (assets->data == NULL || (flags & MP_BUFFER_WRITE)) {
+        return 1;
+    }
+    bufinfo->buf = (void *)(assets->data + self->offset);
+    bufinfo->len = self->size;
+    bufinfo->typecode = 'B';
+    return 0;
+}
+
+
+#ifdef MP_OBJ_TYPE_GET_SLOT
+MP_DEFINE_CONST_OBJ_TYPE(
+    mp_lcd_asset_entry_type,
+    MP_QSTR_AssetEntry,
+    MP_TYPE_FLAG_NONE,
+    print, mp_lcd_asset_entry_print,
+    unary_op, mp_lcd_asset_entry_unary_op,
+    buffer, mp_lcd_asset_entry_get_buffer
+);
+#else
+const mp_obj_type_t mp_lcd_asset_entry_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_AssetEntry,
+    .print = mp_lcd_asset_entry_print,
+    .unary_op = mp_lcd_asset_entry_unary_op,
+    .buffer_p = { .get_buffer = mp_lcd_asset_entry_get_buffer },
+};
+#endif
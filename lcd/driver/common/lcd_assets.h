@@ -0,0 +1,50 @@
+#ifndef _LCD_ASSETS_H_
+#define _LCD_ASSETS_H_
+
+#include "py/obj.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if USE_ESP_LCD
+#include "esp_partition.h"
+#endif
+
+// An asset image, as written by examples/assets/mkassets.py, little endian:
+//
+//   "LCDA", uint32 count
+//   count entries of name (LCD_ASSETS_NAME_LEN bytes, NUL padded), uint32
+//   offset from the start of the image, uint32 size
+//   the data of the entries
+//
+// It is mapped into the address space, from a data partition on the esp32 or
+// from a file elsewhere, so entries are read in place and never copied.
+
+#define LCD_ASSETS_MAGIC      "LCDA"
+#define LCD_ASSETS_NAME_LEN   (24)
+#define LCD_ASSETS_ENTRY_SIZE (LCD_ASSETS_NAME_LEN + 8)
+
+typedef struct _mp_lcd_assets_obj_t {
+    mp_obj_base_t base;
+    const uint8_t *data;    // the mapped image, NULL after deinit()
+    size_t size;
+    uint32_t count;
+#if USE_ESP_LCD
+    esp_partition_mmap_handle_t handle;
+#endif
+} mp_lcd_assets_obj_t;
+
+// assets[name], a read only buffer of the entry in place. It holds the
+// Assets object, so the mapping stays while the entry is in use.
+typedef struct _mp_lcd_asset_entry_obj_t {
+    mp_obj_base_t base;
+    mp_obj_t assets;
+    uint32_t offset;
+    uint32_t size;
+} mp_lcd_asset_entry_obj_t;
+
+extern const mp_obj_type_t mp_lcd_assets_type;
+
+extern const mp_obj_type_t mp_lcd_asset_entry_type;
+
+#endif
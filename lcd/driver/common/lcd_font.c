@@ -0,0 +1,315 @@
+#include "lcd_font.h"
+
+#include "py/obj.h"
+#include "py/runtime.h"
+
+#include <string.h>
+
+
+// attribute of the font module, MP_OBJ_NULL if it has none
+STATIC mp_obj_t font_attr(mp_obj_t obj, qstr attr) {
+    mp_obj_t dest[2];
+    mp_load_method_maybe(obj, attr, dest);
+    return dest[0];
+}
+
+
+STATIC mp_obj_t font_attr_required(mp_obj_t obj, qstr attr) {
+    mp_obj_t value = font_attr(obj, attr);
+    if (value == MP_OBJ_NULL) {
+        mp_raise_ValueError(MP_ERROR_TEXT("not a font"));
+    }
+    return value;
+}
+
+
+STATIC const uint8_t *font_buffer(mp_obj_t obj, qstr attr, size_t *len) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(font_attr_required(obj, attr), &bufinfo, MP_BUFFER_READ);
+    *len = bufinfo.len;
+    return bufinfo.buf;
+}
+
+
+STATIC uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+// section of a packed font described at header offset pos
+STATIC const uint8_t *font_section(const uint8_t *buf, size_t len, size_t pos, size_t *size) {
+    uint32_t offset = get_u32(buf + pos);
+    *size = get_u32(buf + pos + 4);
+    if (offset > len || *size > len - offset) {
+        mp_raise_ValueError(MP_ERROR_TEXT("font truncated"));
+    }
+    return buf + offset;
+}
+
+
+STATIC void font_get_packed(lcd_font_t *font, const uint8_t *buf, size_t len) {
+    if (len < LCD_FONT_HEADER_SIZE || memcmp(buf, LCD_FONT_MAGIC, 4) != 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("not a font"));
+    }
+    size_t offsets_len;
+    font->height = buf[4];
+    font->width = buf[5];
+    font->offset_width = buf[6];
+    font->first = get_u32(buf + 8);
+    font->last = get_u32(buf + 12);
+    font->map = (const char *)font_section(buf, len, 16, &font->map_len);
+    font->widths = font_section(buf, len, 24, &font->glyphs);
+    font->offsets = font_section(buf, len, 32, &offsets_len);
+    font->bitmaps = font_section(buf, len, 40, &font->bitmaps_len);
+    if (font->height == 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("unsupported font height"));
+    }
+    if (font->width) {
+        font->map = NULL;
+    } else if (font->offset_width < 1 || font->offset_width > 4 ||
+               offsets_len < font->glyphs * font->offset_width) {
+        mp_raise_ValueError(MP_ERROR_TEXT("bad font offsets"));
+    }
+}
+
+
+void lcd_font_get(lcd_font_t *font, mp_obj_t obj) {
+    memset(font, 0, sizeof(*font));
+    font->obj = obj;
+
+    mp_buffer_info_t bufinfo;
+    if (mp_get_buffer(obj, &bufinfo, MP_BUFFER_READ)) {
+        font_get_packed(font, bufinfo.buf, bufinfo.len);
+        return;
+    }
+
+    font->height = mp_obj_get_int(font_attr_required(obj, MP_QSTR_HEIGHT));
+    if (font->height <= 0 || font->height > 255) {
+        mp_raise_ValueError(MP_ERROR_TEXT("unsupported font height"));
+    }
+
+    mp_obj_t map = font_attr(obj, MP_QSTR_MAP);
+    if (map == MP_OBJ_NULL) {
+        font->width = mp_obj_get_int(font_attr_required(obj, MP_QSTR_WIDTH));
+        font->first = mp_obj_get_int(font_attr_required(obj, MP_QSTR_FIRST));
+        font->last = mp_obj_get_int(font_attr_required(obj, MP_QSTR_LAST));
+        font->bitmaps = font_buffer(obj, MP_QSTR_FONT, &font->bitmaps_len);
+        if (font->width <= 0 || font->width > 255) {
+            mp_raise_ValueError(MP_ERROR_TEXT("unsupported font width"));
+        }
+        return;
+    }
+
+    mp_obj_t bpp = font_attr(obj, MP_QSTR_BPP);
+    if (bpp != MP_OBJ_NULL && mp_obj_get_int(bpp) != 1) {
+        mp_raise_ValueError(MP_ERROR_TEXT("only 1 bit fonts are supported"));
+    }
+    size_t offsets_len;
+    font->map = mp_obj_str_get_data(map, &font->map_len);
+    font->widths = font_buffer(obj, MP_QSTR_WIDTHS, &font->glyphs);
+    font->offsets = font_buffer(obj, MP_QSTR_OFFSETS, &offsets_len);
+    font->offset_width = mp_obj_get_int(font_attr_required(obj, MP_QSTR_OFFSET_WIDTH));
+    font->bitmaps = font_buffer(obj, MP_QSTR_BITMAPS, &font->bitmaps_len);
+    if (font->offset_width < 1 || font->offset_width > 4 ||
+        offsets_len < font->glyphs * font->offset_width) {
+        mp_raise_ValueError(MP_ERROR_TEXT("bad font offsets"));
+    }
+}
+
+
+const char *lcd_font_next_char(const char *s, const char *end, uint32_t *code) {
+    const uint8_t *p = (const uint8_t *)s;
+    uint32_t c = *p++;
+    int more = 0;
+    if (c >= 0xC0 && c < 0xF8) {
+        more = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : 1;
+    }
+    if (more && end - (const char *)p >= more) {
+        uint32_t u = c & (0x3F >> more);
+        int i = 0;
+        for (; i < more && (p[i] & 0xC0) == 0x80; i++) {
+            u = (u << 6) | (p[i] & 0x3F);
+        }
+        if (i == more) {
+            *code = u;
+            return (const char *)(p + more);
+        }
+    }
+    *code = c;
+    return (const char *)p;
+}
+
+
+bool lcd_font_glyph(const lcd_font_t *font, uint32_t code, lcd_glyph_t *glyph) {
+    if (font->map == NULL) {
+        if (code < font->first || code > font->last) {
+            return false;
+        }
+        size_t row_bytes = (font->width + 7) / 8;
+        size_t offset = (code - font->first) * row_bytes * font->height;
+        if (offset + row_bytes * font->height > font->bitmaps_len) {
+            return false;
+        }
+        glyph->width = font->width;
+        glyph->bit = offset * 8;
+        glyph->row_bits = row_bytes * 8;
+        return true;
+    }
+
+    // the index of the glyph is the position of the character in MAP
+    const char *s = font->map;
+    const char *end = font->map + font->map_len;
+    size_t index = 0;
+    for (;; index++) {
+        if (s >= end || index >= font->glyphs) {
+            return false;
+        }
+        uint32_t c;
+        s = lcd_font_next_char(s, end, &c);
+        if (c == code) {
+            break;
+        }
+    }
+
+    const uint8_t *p = font->offsets + index * font->offset_width;
+    size_t bit = 0;
+    for (int i = 0; i < font->offset_width; i++) {
+        bit = (bit << 8) | p[i];
+    }
+    glyph->width = font->widths[index];
+    glyph->bit = bit;
+    glyph->row_bits = glyph->width;
+    if ((bit + glyph->row_bits * font->height + 7) / 8 > font->bitmaps_len) {
+        return false;
+    }
+    return true;
+}
+
+
+// bumped by lcd_glyph_cache_invalidate(), caches of an older one are stale
+STATIC uint32_t glyph_cache_generation;
+
+
+void lcd_glyph_cache_init(lcd_glyph_cache_t *cache, size_t pixel_bytes, lcd_panel_convert_t convert) {
+    memset(cache, 0, sizeof(*cache));
+    cache->pixel_bytes = pixel_bytes;
+    cache->convert = convert;
+    cache->generation = glyph_cache_generation;
+}
+
+
+void lcd_glyph_cache_invalidate(void) {
+    glyph_cache_generation++;
+}
+
+
+STATIC void glyph_cache_free(lcd_glyph_cache_t *cache, lcd_glyph_entry_t *e) {
+    size_t size = e->width * e->height * cache->pixel_bytes;
+    if (e->pixels) {
+        m_del(uint8_t, e->pixels, size);
+    }
+    cache->bytes -= size;
+    e->font = MP_OBJ_NULL;
+    e->pixels = NULL;
+}
+
+
+void lcd_glyph_cache_clear(lcd_glyph_cache_t *cache) {
+    for (size_t i = 0; i < LCD_GLYPH_CACHE_ENTRIES; i++) {
+        if (cache->entries[i].font != MP_OBJ_NULL) {
+            glyph_cache_free(cache, &cache->entries[i]);
+        }
+    }
+}
+
+
+// least recently used entry, NULL if the cache is empty
+STATIC lcd_glyph_entry_t *glyph_cache_oldest(lcd_glyph_cache_t *cache) {
+    lcd_glyph_entry_t *oldest = NULL;
+    for (size_t i = 0; i < LCD_GLYPH_CACHE_ENTRIES; i++) {
+        lcd_glyph_entry_t *e = &cache->entries[i];
+        if (e->font != MP_OBJ_NULL && (oldest == NULL || (int32_t)(e->used - oldest->used) < 0)) {
+            oldest = e;
+        }
+    }
+    return oldest;
+}
+
+
+STATIC void glyph_expand(uint16_t *out, const lcd_font_t *font, const lcd_glyph_t *glyph,
+                         uint16_t fg, uint16_t bg) {
+    for (int y = 0; y < font->height; y++) {
+        size_t bit = glyph->bit + y * glyph->row_bits;
+        for (int x = 0; x < glyph->width; x++, bit++) {
+            *out++ = (font->bitmaps[bit >> 3] & (0x80 >> (bit & 7))) ? fg : bg;
+        }
+    }
+}
+
+
+const lcd_glyph_entry_t *lcd_glyph_cache_get(lcd_glyph_cache_t *cache, const lcd_font_t *font,
+                                             uint32_t code, uint16_t fg, uint16_t bg) {
+    if (cache->generation != glyph_cache_generation) {
+        lcd_glyph_cache_clear(cache);
+        cache->generation = glyph_cache_generation;
+    }
+    cache->clock++;
+    for (size_t i = 0; i < LCD_GLYPH_CACHE_ENTRIES; i++) {
+        lcd_glyph_entry_t *e = &cache->entries[i];
+        if (e->code == code && e->bitmaps == font->bitmaps && e->font != MP_OBJ_NULL &&
+            e->fg == fg && e->bg == bg) {
+            e->used = cache->clock;
+            cache->hits++;
+            return e;
+        }
+    }
+
+    lcd_glyph_t glyph;
+    if (!lcd_font_glyph(font, code, &glyph)) {
+        return NULL;
+    }
+    cache->misses++;
+
+    // make room, the glyphs not used for the longest time go first
+    size_t pixels = glyph.width * font->height;
+    size_t size = pixels * cache->pixel_bytes;
+    lcd_glyph_entry_t *e;
+    while (cache->bytes + size > LCD_GLYPH_CACHE_BYTES && (e = glyph_cache_oldest(cache)) != NULL) {
+        glyph_cache_free(cache, e);
+    }
+    e = NULL;
+    for (size_t i = 0; i < LCD_GLYPH_CACHE_ENTRIES && e == NULL; i++) {
+        if (cache->entries[i].font == MP_OBJ_NULL) {
+            e = &cache->entries[i];
+        }
+    }
+    if (e == NULL) {
+        e = glyph_cache_oldest(cache);
+        glyph_cache_free(cache, e);
+    }
+
+    uint8_t *out = NULL;
+    if (size) {
+        out = m_new(uint8_t, size);
+        if (cache->convert) {
+            uint16_t *colors = m_new(uint16_t, pixels);
+            glyph_expand(colors, font, &glyph, fg, bg);
+            cache->convert(out, colors, pixels);
+            m_del(uint16_t, colors, pixels);
+        } else {
+            glyph_expand((uint16_t *)out, font, &glyph, fg, bg);
+        }
+    }
+
+    e->font = font->obj;
+    e->bitmaps = font->bitmaps;
+    e->code = code;
+    e->fg = fg;
+    e->bg = bg;
+    e->width = glyph.width;
+    e->height = font->height;
+    e->used = cache->clock;
+    e->pixels = out;
+    cache->bytes += size;
+    return e;
+}
@@ -0,0 +1,112 @@
+#ifndef _LCD_FONT_H_
+#define _LCD_FONT_H_
+
+#include "lcd_panel_convert.h"
+
+#include "py/obj.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fonts hold 1 bit per pixel glyphs, most significant bit first. Two layouts
+// of font modules are understood:
+//
+// - fixed width ("romfonts"): WIDTH, HEIGHT, FIRST, LAST and FONT, the glyphs
+//   of the codes FIRST to LAST one after the other, every row padded to bytes.
+// - proportional: HEIGHT, MAP (the characters, as a str), WIDTHS (a byte per
+//   glyph), OFFSETS (OFFSET_WIDTH big endian bytes per glyph, the bit the glyph
+//   starts at) and BITMAPS, rows not padded. BPP must be 1 if it is present.
+//
+// Either one can also be packed into a buffer, e.g. an entry of lcd.Assets,
+// so the glyphs are read from where the buffer is. Little endian:
+//
+//   "LCDF", uint8 height, uint8 width (0 if proportional), uint8 offset width,
+//   uint8 0, uint32 first, uint32 last, then offset and size (uint32 each,
+//   from the start of the buffer) of MAP, WIDTHS, OFFSETS and BITMAPS.
+
+#define LCD_FONT_MAGIC       "LCDF"
+#define LCD_FONT_HEADER_SIZE (48)
+
+#ifndef LCD_GLYPH_CACHE_ENTRIES
+#define LCD_GLYPH_CACHE_ENTRIES (64)
+#endif
+
+// colorized glyphs kept at most, in bytes
+#ifndef LCD_GLYPH_CACHE_BYTES
+#define LCD_GLYPH_CACHE_BYTES (32 * 1024)
+#endif
+
+typedef struct _lcd_font_t {
+    mp_obj_t obj;
+    int height;
+    int width;               // of every glyph, 0 for a proportional font
+    uint32_t first;          // fixed width: codes in FONT
+    uint32_t last;
+    const uint8_t *bitmaps;  // FONT or BITMAPS
+    size_t bitmaps_len;
+    const char *map;         // proportional: MAP, WIDTHS and OFFSETS
+    size_t map_len;
+    const uint8_t *widths;
+    size_t glyphs;
+    const uint8_t *offsets;
+    int offset_width;
+} lcd_font_t;
+
+typedef struct _lcd_glyph_t {
+    int width;
+    size_t bit;       // first bit of the glyph in bitmaps
+    size_t row_bits;  // from one row of the glyph to the next
+} lcd_glyph_t;
+
+typedef struct _lcd_glyph_entry_t {
+    mp_obj_t font;    // MP_OBJ_NULL if the entry is free, keeps the font alive otherwise
+    const uint8_t *bitmaps; // identifies the font, every view of a packed one has the same
+    uint32_t code;
+    uint16_t fg;
+    uint16_t bg;
+    uint16_t width;
+    uint16_t height;
+    uint32_t used;    // cache clock at the last lookup
+    uint8_t *pixels;  // width * height pixels, row after row
+} lcd_glyph_entry_t;
+
+typedef struct _lcd_glyph_cache_t {
+    size_t pixel_bytes;
+    lcd_panel_convert_t convert;  // colors to the format of pixels, NULL if the same
+    uint32_t clock;
+    size_t bytes;                 // used by all pixels
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t generation;          // of lcd_glyph_cache_invalidate() the entries belong to
+    lcd_glyph_entry_t entries[LCD_GLYPH_CACHE_ENTRIES];
+} lcd_glyph_cache_t;
+
+// Read the layout of the font module or packed font obj, raises if it is none
+// of the above.
+void lcd_font_get(lcd_font_t *font, mp_obj_t obj);
+
+// Where the glyph of code is, false if the font has none.
+bool lcd_font_glyph(const lcd_font_t *font, uint32_t code, lcd_glyph_t *glyph);
+
+// Decode the UTF-8 character at s, returns where the next one starts. Bytes
+// that are not valid UTF-8 are taken as they are.
+const char *lcd_font_next_char(const char *s, const char *end, uint32_t *code);
+
+// Glyphs are stored converted to pixel_bytes per pixel by convert.
+void lcd_glyph_cache_init(lcd_glyph_cache_t *cache, size_t pixel_bytes, lcd_panel_convert_t convert);
+
+void lcd_glyph_cache_clear(lcd_glyph_cache_t *cache);
+
+// Drop the entries of every cache at their next lookup. Called when memory
+// glyphs were read from goes away, e.g. an unmapped lcd.Assets, as another
+// font may show up at the same address.
+void lcd_glyph_cache_invalidate(void);
+
+// The glyph of code drawn in fg on bg, rendered into the cache if it is not
+// there yet, NULL if the font has no such glyph. The entry stays valid until
+// the next lookup.
+const lcd_glyph_entry_t *lcd_glyph_cache_get(lcd_glyph_cache_t *cache, const lcd_font_t *font,
+                                             uint32_t code, uint16_t fg, uint16_t bg);
+
+#endif
@@ -0,0 +1,138 @@
+#include "lcd_image.h"
+
+#include "py/obj.h"
+#include "py/runtime.h"
+
+#include <string.h>
+
+#define QOI_OP_INDEX (0x00)
+#define QOI_OP_DIFF  (0x40)
+#define QOI_OP_LUMA  (0x80)
+#define QOI_OP_RUN   (0xC0)
+#define QOI_OP_RGB   (0xFE)
+#define QOI_OP_RGBA  (0xFF)
+
+
+STATIC uint32_t get_u32_be(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+
+// raise unless n more bytes of data are left
+STATIC void image_need(const lcd_image_t *image, size_t n) {
+    if (image->len - image->pos < n) {
+        mp_raise_ValueError(MP_ERROR_TEXT("image data truncated"));
+    }
+}
+
+
+void lcd_image_open(lcd_image_t *image, const uint8_t *buf, size_t len) {
+    memset(image, 0, sizeof(*image));
+    image->data = buf;
+    image->len = len;
+
+    if (len >= LCD_IMAGE_RLE_HEADER_SIZE && memcmp(buf, LCD_IMAGE_RLE_MAGIC, 4) == 0) {
+        image->format = LCD_IMAGE_RLE;
+        image->width = buf[4] | (buf[5] << 8);
+        image->height = buf[6] | (buf[7] << 8);
+        image->pos = LCD_IMAGE_RLE_HEADER_SIZE;
+    } else if (len >= LCD_IMAGE_QOI_HEADER_SIZE && memcmp(buf, LCD_IMAGE_QOI_MAGIC, 4) == 0) {
+        uint32_t width = get_u32_be(buf + 4);
+        uint32_t height = get_u32_be(buf + 8);
+        if (width > 0xFFFF || height > 0xFFFF || (buf[12] != 3 && buf[12] != 4)) {
+            mp_raise_ValueError(MP_ERROR_TEXT("unsupported image"));
+        }
+        image->format = LCD_IMAGE_QOI;
+        image->width = width;
+        image->height = height;
+        image->pos = LCD_IMAGE_QOI_HEADER_SIZE;
+        image->px[3] = 255;
+    } else {
+        mp_raise_ValueError(MP_ERROR_TEXT("not a compressed image"));
+    }
+}
+
+
+// start the next packet of an RLE image
+STATIC void rle_next(lcd_image_t *image) {
+    image_need(image, 1);
+    uint8_t n = image->data[image->pos++];
+    image->run = (n & 0x7F) + 1;
+    image->literal = !(n & 0x80);
+    if (!image->literal) {
+        image_need(image, 2);
+        memcpy(&image->color, image->data + image->pos, 2);
+        image->pos += 2;
+    }
+}
+
+
+// decode the next chunk of a QOI image, a run or a single pixel
+STATIC void qoi_next(lcd_image_t *image) {
+    const uint8_t *p = image->data + image->pos;
+    uint8_t *px = image->px;
+    image_need(image, 1);
+    uint8_t b1 = *p++;
+    image->run = 1;
+
+    if (b1 == QOI_OP_RGB) {
+        image_need(image, 4);
+        memcpy(px, p, 3);
+        p += 3;
+    } else if (b1 == QOI_OP_RGBA) {
+        image_need(image, 5);
+        memcpy(px, p, 4);
+        p += 4;
+    } else if ((b1 & 0xC0) == QOI_OP_INDEX) {
+        memcpy(px, image->index[b1], 4);
+    } else if ((b1 & 0xC0) == QOI_OP_DIFF) {
+        px[0] += ((b1 >> 4) & 0x03) - 2;
+        px[1] += ((b1 >> 2) & 0x03) - 2;
+        px[2] += (b1 & 0x03) - 2;
+    } else if ((b1 & 0xC0) == QOI_OP_LUMA) {
+        image_need(image, 2);
+        uint8_t b2 = *p++;
+        int vg = (b1 & 0x3F) - 32;
+        px[0] += vg - 8 + ((b2 >> 4) & 0x0F);
+        px[1] += vg;
+        px[2] += vg - 8 + (b2 & 0x0F);
+    } else {
+        image->run = (b1 & 0x3F) + 1;
+    }
+    image->pos = p - image->data;
+
+    memcpy(image->index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+    uint16_t c = ((px[0] & 0xF8) << 8) | ((px[1] & 0xFC) << 3) | (px[2] >> 3);
+    image->color = (c >> 8) | (c << 8);
+}
+
+
+void lcd_image_read(lcd_image_t *image, uint16_t *out, size_t n) {
+    while (n) {
+        if (image->run == 0) {
+            if (image->format == LCD_IMAGE_RLE) {
+                rle_next(image);
+            } else {
+                qoi_next(image);
+            }
+        }
+        size_t count = (n < image->run) ? n : image->run;
+        if (image->literal) {
+            image_need(image, count * 2);
+            if (out) {
+                memcpy(out, image->data + image->pos, count * 2);
+            }
+            image->pos += count * 2;
+        } else if (out) {
+            uint16_t color = image->color;
+            for (size_t i = 0; i < count; i++) {
+                out[i] = color;
+            }
+        }
+        if (out) {
+            out += count;
+        }
+        image->run -= count;
+        n -= count;
+    }
+}
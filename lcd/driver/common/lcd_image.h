@@ -0,0 +1,50 @@
+#ifndef _LCD_IMAGE_H_
+#define _LCD_IMAGE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Compressed images are decoded pixel by pixel into RGB565_SWAPPED colors, so
+// only as much of the image as fits into a transfer buffer is ever unpacked.
+// Two formats are understood, told apart by their magic:
+//
+// - "LCDR", uint16 width, uint16 height (little endian), then packets of a
+//   control byte n: with bit 7 set, the following color repeated (n & 0x7F) + 1
+//   times, otherwise n + 1 colors as they are. Colors are 2 bytes big endian
+//   RGB565, like bitmap() data, runs may go on into the next row.
+// - QOI (https://qoiformat.org), RGB or RGBA. Alpha is ignored.
+
+#define LCD_IMAGE_RLE_MAGIC       "LCDR"
+#define LCD_IMAGE_RLE_HEADER_SIZE (8)
+#define LCD_IMAGE_QOI_MAGIC       "qoif"
+#define LCD_IMAGE_QOI_HEADER_SIZE (14)
+
+enum {
+    LCD_IMAGE_RLE,
+    LCD_IMAGE_QOI,
+};
+
+typedef struct _lcd_image_t {
+    int format;
+    int width;
+    int height;
+    const uint8_t *data;
+    size_t len;
+    size_t pos;           // next byte of data to decode
+    size_t run;           // pixels left in the current run
+    bool literal;         // RLE: the run is made of colors as they are
+    uint16_t color;       // color of the run
+    uint8_t px[4];        // QOI: last pixel, r g b a
+    uint8_t index[64][4]; // QOI: pixels seen, by hash
+} lcd_image_t;
+
+// Read the header of the compressed image in buf, raises if it is neither
+// format.
+void lcd_image_open(lcd_image_t *image, const uint8_t *buf, size_t len);
+
+// Decode the next n pixels to out, or skip them if out is NULL. Raises if
+// the data ends early.
+void lcd_image_read(lcd_image_t *image, uint16_t *out, size_t n);
+
+#endif
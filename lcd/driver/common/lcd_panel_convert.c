@@ -0,0 +1,184 @@
+#include "lcd_panel_convert.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+// The kernels work on two pixels at once, held in the two 16 bit lanes of a
+// 32 bit word (SWAR), so the channel math is done once per pair. Results are
+// masked so no lane ever carries into the other. Word loads assume a little
+// endian cpu, like the esp32 and the hosts the unix port runs on.
+//
+// src and dst may be at any address, e.g. a memoryview slice at an odd
+// offset. The esp32 faults on unaligned 16 and 32 bit accesses, so those
+// go through memcpy, which the compiler turns into byte accesses.
+
+static inline uint32_t load16(const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return v;
+}
+
+
+static inline uint32_t load32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+
+static inline void store16(uint8_t *p, uint32_t v) {
+    uint16_t h = v;
+    memcpy(p, &h, 2);
+}
+
+
+static inline uint32_t swap_lanes(uint32_t w) {
+    return ((w & 0x00FF00FF) << 8) | ((w >> 8) & 0x00FF00FF);
+}
+
+
+static inline void put_rgb888(uint8_t *dst, uint32_t w, int lanes) {
+    uint32_t r = (w >> 11) & 0x001F001F;
+    uint32_t g = (w >> 5) & 0x003F003F;
+    uint32_t b = w & 0x001F001F;
+
+    // repeat the top bits in the new low bits, so white stays white
+    r = (r << 3) | ((r >> 2) & 0x00070007);
+    g = (g << 2) | ((g >> 4) & 0x00030003);
+    b = (b << 3) | ((b >> 2) & 0x00070007);
+
+    dst[0] = r;
+    dst[1] = g;
+    dst[2] = b;
+    if (lanes == 2) {
+        dst[3] = r >> 16;
+        dst[4] = g >> 16;
+        dst[5] = b >> 16;
+    }
+}
+
+
+static inline void put_rgb666(uint8_t *dst, uint32_t w, int lanes) {
+    uint32_t r = (w >> 11) & 0x001F001F;
+    uint32_t g = (w >> 5) & 0x003F003F;
+    uint32_t b = w & 0x001F001F;
+
+    r = ((r << 1) | ((r >> 4) & 0x00010001)) << 2;
+    g = g << 2;
+    b = ((b << 1) | ((b >> 4) & 0x00010001)) << 2;
+
+    dst[0] = r;
+    dst[1] = g;
+    dst[2] = b;
+    if (lanes == 2) {
+        dst[3] = r >> 16;
+        dst[4] = g >> 16;
+        dst[5] = b >> 16;
+    }
+}
+
+
+// Expand to 3 bytes per pixel. A leading pixel is done on its own until src
+// is word aligned, a trailing one uses only the low lane. src at an odd
+// address never gets aligned and is read with byte loads throughout.
+static inline void expand(uint8_t *dst, const uint16_t *src_in, size_t pixels, bool swap, bool rgb888) {
+    const uint8_t *src = (const uint8_t *)src_in;
+
+    if (((uintptr_t)src & 3) == 2 && pixels > 0) {
+        uint32_t w = load16(src);
+        w = swap ? swap_lanes(w) : w;
+        rgb888 ? put_rgb888(dst, w, 1) : put_rgb666(dst, w, 1);
+        src += 2;
+        dst += 3;
+        pixels--;
+    }
+
+    bool aligned = ((uintptr_t)src & 3) == 0;
+    for (; pixels >= 2; pixels -= 2) {
+        uint32_t w = aligned ? *(const uint32_t *)src : load32(src);
+        if (swap) {
+            w = swap_lanes(w);
+        }
+        rgb888 ? put_rgb888(dst, w, 2) : put_rgb666(dst, w, 2);
+        src += 4;
+        dst += 6;
+    }
+
+    if (pixels) {
+        uint32_t w = load16(src);
+        w = swap ? swap_lanes(w) : w;
+        rgb888 ? put_rgb888(dst, w, 1) : put_rgb666(dst, w, 1);
+    }
+}
+
+
+static void rgb565_to_rgb888(uint8_t *dst, const uint16_t *src, size_t pixels) {
+    expand(dst, src, pixels, false, true);
+}
+
+
+static void rgb565_swapped_to_rgb888(uint8_t *dst, const uint16_t *src, size_t pixels) {
+    expand(dst, src, pixels, true, true);
+}
+
+
+static void rgb565_to_rgb666(uint8_t *dst, const uint16_t *src, size_t pixels) {
+    expand(dst, src, pixels, false, false);
+}
+
+
+static void rgb565_swapped_to_rgb666(uint8_t *dst, const uint16_t *src, size_t pixels) {
+    expand(dst, src, pixels, true, false);
+}
+
+
+// RGB565 <-> RGB565_SWAPPED, a word at a time when src and dst allow it
+static void rgb565_swap(uint8_t *dst, const uint16_t *src_in, size_t pixels) {
+    const uint8_t *src = (const uint8_t *)src_in;
+
+    if ((((uintptr_t)src ^ (uintptr_t)dst) & 3) == 0 && ((uintptr_t)src & 1) == 0) {
+        if (((uintptr_t)src & 3) != 0 && pixels > 0) {
+            store16(dst, swap_lanes(load16(src)));
+            src += 2;
+            dst += 2;
+            pixels--;
+        }
+        for (; pixels >= 2; pixels -= 2) {
+            *(uint32_t *)dst = swap_lanes(*(const uint32_t *)src);
+            src += 4;
+            dst += 4;
+        }
+    }
+    for (; pixels; pixels--) {
+        store16(dst, swap_lanes(load16(src)));
+        src += 2;
+        dst += 2;
+    }
+}
+
+
+lcd_panel_convert_t lcd_panel_convert_get(int src_format, int dst_format) {
+    bool swapped = src_format == PIXEL_FORMAT_RGB565_SWAPPED;
+
+    switch (dst_format) {
+        case PIXEL_FORMAT_RGB565:
+            return swapped ? rgb565_swap : NULL;
+
+        case PIXEL_FORMAT_RGB565_SWAPPED:
+            return swapped ? NULL : rgb565_swap;
+
+        case PIXEL_FORMAT_RGB666:
+            return swapped ? rgb565_swapped_to_rgb666 : rgb565_to_rgb666;
+
+        case PIXEL_FORMAT_RGB888:
+            return swapped ? rgb565_swapped_to_rgb888 : rgb565_to_rgb888;
+
+        default:
+            return NULL;
+    }
+}
+
+
+size_t lcd_panel_format_bytes(int format) {
+    return (format == PIXEL_FORMAT_RGB666 || format == PIXEL_FORMAT_RGB888) ? 3 : 2;
+}
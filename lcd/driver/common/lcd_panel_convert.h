@@ -0,0 +1,22 @@
+#ifndef _LCD_PANEL_CONVERT_H_
+#define _LCD_PANEL_CONVERT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// pixel formats, as stored in memory
+#define PIXEL_FORMAT_RGB565         (0) // native byte order, like framebuf.RGB565
+#define PIXEL_FORMAT_RGB565_SWAPPED (1) // big endian, as the panel expects it and colorRGB() returns it
+#define PIXEL_FORMAT_RGB666         (2) // 3 bytes, 6 bits each, left aligned
+#define PIXEL_FORMAT_RGB888         (3) // 3 bytes
+
+// convert pixels RGB565 values from src into another format in dst
+typedef void (*lcd_panel_convert_t)(uint8_t *dst, const uint16_t *src, size_t pixels);
+
+// Returns the kernel converting from the RGB565 format src_format to
+// dst_format, NULL if the data can be sent as it is.
+lcd_panel_convert_t lcd_panel_convert_get(int src_format, int dst_format);
+
+size_t lcd_panel_format_bytes(int format);
+
+#endif
@@ -0,0 +1,88 @@
+// Host test of the conversion kernels against a per pixel reference, for
+// every alignment of src and dst and lengths around the word size.
+// Build and run with `make -C lcd test`.
+
+#include "lcd_panel_convert.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_PIXELS (13)
+#define GUARD      (0xAA)
+
+
+// what the kernel has to write for the RGB565 value v, in dst_format
+static size_t reference(uint8_t *dst, uint16_t v, int dst_format) {
+    unsigned r = (v >> 11) & 0x1F;
+    unsigned g = (v >> 5) & 0x3F;
+    unsigned b = v & 0x1F;
+
+    switch (dst_format) {
+        case PIXEL_FORMAT_RGB565:
+            memcpy(dst, &v, 2);
+            return 2;
+        case PIXEL_FORMAT_RGB565_SWAPPED:
+            dst[0] = v >> 8;
+            dst[1] = v;
+            return 2;
+        case PIXEL_FORMAT_RGB666:
+            dst[0] = ((r << 1) | (r >> 4)) << 2;
+            dst[1] = g << 2;
+            dst[2] = ((b << 1) | (b >> 4)) << 2;
+            return 3;
+        default:
+            dst[0] = (r << 3) | (r >> 2);
+            dst[1] = (g << 2) | (g >> 4);
+            dst[2] = (b << 3) | (b >> 2);
+            return 3;
+    }
+}
+
+
+int main(void) {
+    uint8_t src[MAX_PIXELS * 2 + 4];
+    uint8_t dst[MAX_PIXELS * 3 + 8];
+    uint8_t expect[sizeof(dst)];
+    int cases = 0;
+    int failed = 0;
+
+    for (int src_format = PIXEL_FORMAT_RGB565; src_format <= PIXEL_FORMAT_RGB565_SWAPPED; src_format++) {
+        for (int dst_format = PIXEL_FORMAT_RGB565; dst_format <= PIXEL_FORMAT_RGB888; dst_format++) {
+            lcd_panel_convert_t convert = lcd_panel_convert_get(src_format, dst_format);
+            if (convert == NULL) {
+                continue;
+            }
+            for (int src_offset = 0; src_offset < 4; src_offset++) {
+                for (int dst_offset = 0; dst_offset < 4; dst_offset++) {
+                    for (int pixels = 0; pixels <= MAX_PIXELS; pixels++) {
+                        for (size_t i = 0; i < sizeof(src); i++) {
+                            src[i] = i * 37 + pixels * 11 + src_offset;
+                        }
+                        memset(dst, GUARD, sizeof(dst));
+                        memset(expect, GUARD, sizeof(expect));
+
+                        const uint8_t *in = src + src_offset;
+                        uint8_t *out = expect + dst_offset;
+                        for (int i = 0; i < pixels; i++) {
+                            uint16_t v = (src_format == PIXEL_FORMAT_RGB565_SWAPPED)
+                                ? (in[2 * i] << 8) | in[2 * i + 1]
+                                : in[2 * i] | (in[2 * i + 1] << 8);
+                            out += reference(out, v, dst_format);
+                        }
+
+                        convert(dst + dst_offset, (const uint16_t *)in, pixels);
+                        cases++;
+                        if (memcmp(dst, expect, sizeof(dst)) != 0) {
+                            failed++;
+                            printf("FAIL %d -> %d, src offset %d, dst offset %d, %d pixels\n",
+                                src_format, dst_format, src_offset, dst_offset, pixels);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    printf("lcd_panel_convert: %d cases, %d failed\n", cases, failed);
+    return failed != 0;
+}
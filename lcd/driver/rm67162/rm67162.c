@@ -1,8 +1,20 @@
 #include "rm67162.h"
 #include "lcd_panel.h"
+#if USE_ESP_LCD
 #include "qspi_panel.h"
+#include "esp32.h"
+#endif
+#if EMULATED_LCD_SUPPORTED
+#include "emulated_panel.h"
+#endif
 #include "lcd_panel_commands.h"
 #include "lcd_panel_types.h"
+#include "lcd_panel_convert.h"
+#include "display_list.h"
+#include "lcd_font.h"
+#include "lcd_image.h"
+#include "lcd_panel_stats.h"
+#include "lcd_trace.h"
 #include "rm67162_rotation.h"
 
 #include "py/obj.h"
@@ -10,9 +22,74 @@
 #include "mphalport.h"
 #include "py/gc.h"
 
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 
+// size of the fill buffer in bytes. Fills larger than this stream the same
+// buffer repeatedly, so it does not need to cover the whole screen.
+#define RM67162_FRAME_BUFFER_SIZE (4096)
+
+// present() gives up waiting for a TE pulse after two frames at 30 Hz
+#define RM67162_TE_TIMEOUT_US (66 * 1000)
+
+// largest transfer buffer of text(), longer runs are sent in bands
+#define RM67162_TEXT_BUFFER_SIZE (16 * 1024)
+
+// size of each of the two transfer buffers bitmap_compressed() decodes into
+#define RM67162_DECODE_BUFFER_SIZE (4096)
+
+// number of separate areas tracked in shadow mode before they get merged
+#define RM67162_DIRTY_RECTS (8)
+
+typedef struct _rm67162_rect_t {
+    uint16_t x0;
+    uint16_t y0;
+    uint16_t x1;
+    uint16_t y1;
+} rm67162_rect_t;
+
+
+// primitives stats() keeps a latency histogram for, named in rm67162_stat_names
+enum {
+    RM67162_STAT_PIXEL,
+    RM67162_STAT_HLINE,
+    RM67162_STAT_VLINE,
+    RM67162_STAT_FILL,
+    RM67162_STAT_RECT,
+    RM67162_STAT_FILL_RECT,
+    RM67162_STAT_CIRCLE,
+    RM67162_STAT_FILL_CIRCLE,
+    RM67162_STAT_BITMAP,
+    RM67162_STAT_BITMAP_COMPRESSED,
+    RM67162_STAT_PIXELS,
+    RM67162_STAT_HLINES,
+    RM67162_STAT_FILL_RECTS,
+    RM67162_STAT_LINE,
+    RM67162_STAT_POLYLINE,
+    RM67162_STAT_FILL_POLYGON,
+    RM67162_STAT_FILL_TRIANGLE,
+    RM67162_STAT_TEXT,
+    RM67162_STAT_REPLAY,
+    RM67162_STAT_SHOW,
+    RM67162_STAT_PRESENT,
+    RM67162_STATS
+};
+
+typedef struct _rm67162_stats_t {
+    uint32_t param_transactions;  // calls into the bus, whatever bus it is
+    uint32_t color_transactions;
+    uint64_t param_bytes;
+    uint64_t color_bytes;
+    uint32_t frames;              // present() calls
+    uint32_t late_frames;         // frames that missed their deadline by a whole period
+    uint64_t pace_wait_us;        // time present() slept to keep target_fps()
+    uint64_t te_wait_us;          // time present() waited for the TE pulse
+    lcd_stats_hist_t latency[RM67162_STATS];
+} rm67162_stats_t;
+
+
 // this is the actual C-structure for our new object
 typedef struct _mp_lcd_rm67162_obj_t {
     mp_obj_base_t base;
@@ -32,20 +109,88 @@ typedef struct _mp_lcd_rm67162_obj_t {
     int y_gap;
     uint32_t bpp;
     uint8_t fb_bpp;
+    uint8_t pixel_format;        // format the panel is fed with, PIXEL_FORMAT_*
+    uint8_t pixel_bytes;         // bytes per pixel in that format
+    lcd_panel_convert_t convert; // colors (RGB565_SWAPPED) to pixel_format, NULL if the same
     uint8_t madctl_val; // save current value of LCD_CMD_MADCTL register
     uint8_t colmod_cal; // save surrent value of LCD_CMD_COLMOD register
+    bool window_valid;  // window_* below match the GRAM window of the panel
+    uint16_t window_x0; // last window sent with LCD_CMD_CASET/LCD_CMD_RASET
+    uint16_t window_y0;
+    uint16_t window_x1;
+    uint16_t window_y1;
 
 /*     mp_buffer_info_t frame_buffer;
  */
     size_t frame_buffer_size;                       // frame buffer size in bytes
-    uint16_t *frame_buffer;                         // frame buffer
+    uint16_t *frame_buffer;                         // fill pattern / scratch buffer
+    uint16_t frame_buffer_color;                    // color the frame buffer is filled with
+    size_t frame_buffer_filled;                     // pixels already filled with that color
+
+    uint16_t *shadow;                               // full screen shadow buffer, NULL if not retained
+    uint8_t dirty_count;                            // number of used dirty_rects
+    rm67162_rect_t dirty_rects[RM67162_DIRTY_RECTS]; // areas of the shadow not yet shown
+
+    mp_obj_t te;                                    // tearing effect input pin
+    void *te_edge;                                  // rising edges of the te pin, from the hal
+    bool te_enabled;                                // TE output of the panel is on
+    uint32_t frame_us;                              // frame period of present(), 0 if not paced
+    uint32_t frame_deadline;                        // ticks_us the next frame is due
+    mp_obj_t flag_type;                             // asyncio.ThreadSafeFlag, found on the first *_async() call
+
+    lcd_glyph_cache_t *glyph_cache;                 // colorized glyphs of text(), NULL until first used
+    uint8_t *text_buffer;                           // transfer buffer of text()
+    size_t text_buffer_size;
+    uint8_t *decode_buffer;                         // two transfer buffers of bitmap_compressed(), NULL until first used
+
+    rm67162_stats_t stats;
 } mp_lcd_rm67162_obj_t;
 
 
+STATIC const qstr rm67162_stat_names[RM67162_STATS] = {
+    [RM67162_STAT_PIXEL]       = MP_QSTR_pixel,
+    [RM67162_STAT_HLINE]       = MP_QSTR_hline,
+    [RM67162_STAT_VLINE]       = MP_QSTR_vline,
+    [RM67162_STAT_FILL]        = MP_QSTR_fill,
+    [RM67162_STAT_RECT]        = MP_QSTR_rect,
+    [RM67162_STAT_FILL_RECT]   = MP_QSTR_fill_rect,
+    [RM67162_STAT_CIRCLE]      = MP_QSTR_circle,
+    [RM67162_STAT_FILL_CIRCLE] = MP_QSTR_fill_circle,
+    [RM67162_STAT_BITMAP]      = MP_QSTR_bitmap,
+    [RM67162_STAT_BITMAP_COMPRESSED] = MP_QSTR_bitmap_compressed,
+    [RM67162_STAT_PIXELS]      = MP_QSTR_pixels,
+    [RM67162_STAT_HLINES]      = MP_QSTR_hlines,
+    [RM67162_STAT_FILL_RECTS]  = MP_QSTR_fill_rects,
+    [RM67162_STAT_LINE]        = MP_QSTR_line,
+    [RM67162_STAT_POLYLINE]    = MP_QSTR_polyline,
+    [RM67162_STAT_FILL_POLYGON] = MP_QSTR_fill_polygon,
+    [RM67162_STAT_FILL_TRIANGLE] = MP_QSTR_fill_triangle,
+    [RM67162_STAT_TEXT]        = MP_QSTR_text,
+    [RM67162_STAT_REPLAY]      = MP_QSTR_replay,
+    [RM67162_STAT_SHOW]        = MP_QSTR_show,
+    [RM67162_STAT_PRESENT]     = MP_QSTR_present,
+};
+
+
+// time the drawing part of a primitive into its latency histogram and the trace
+#define STATS_START(stat) \
+    LCD_TRACE_BEGIN(rm67162_stat_names[stat], LCD_TRACE_DRIVER); \
+    uint32_t stats_start = mp_hal_ticks_us()
+#define STATS_STOP(self, stat) \
+    lcd_stats_hist_add(&(self)->stats.latency[stat], mp_hal_ticks_us() - stats_start); \
+    LCD_TRACE_END(rm67162_stat_names[stat], LCD_TRACE_DRIVER, 0)
+
+
 #define _swap_int16_t(a, b) { int16_t t = a; a = b; b = t; }
 #define _swap_bytes(val) ((((val) >> 8) & 0x00FF) | (((val) << 8) & 0xFF00))
 
 #define ABS(N) (((N) < 0) ? (-(N)) : (N))
+#ifndef MIN
+#define MIN(A, B) (((A) < (B)) ? (A) : (B))
+#endif
+#ifndef MAX
+#define MAX(A, B) (((A) > (B)) ? (A) : (B))
+#endif
 #define mp_hal_delay_ms(delay) (mp_hal_delay_us(delay * 1000))
 
 STATIC volatile bool lcd_panel_active = false;
@@ -64,6 +209,39 @@ Below are transmission related functions.
 STATIC void write_color(mp_lcd_rm67162_obj_t *self, const void *buf, int len) {
     if (self->lcd_panel_p) {
             self->lcd_panel_p->tx_color(self->bus_obj, 0, buf, len);
+            self->stats.color_transactions++;
+            self->stats.color_bytes += len;
+    }
+}
+
+
+// The next write_color() sends data held by obj, a bus sending it without a
+// copy keeps obj alive until it is sent.
+STATIC void write_source(mp_lcd_rm67162_obj_t *self, mp_obj_t obj) {
+    if (self->lcd_panel_p && self->lcd_panel_p->source) {
+        self->lcd_panel_p->source(self->bus_obj, obj);
+    }
+}
+
+
+// Send len bytes made of buf repeated, buf_len must be a multiple of the pixel size.
+STATIC void write_pattern(mp_lcd_rm67162_obj_t *self, const void *buf, int buf_len, int len) {
+    if (self->lcd_panel_p) {
+            self->lcd_panel_p->tx_pattern(self->bus_obj, 0, buf, buf_len, len);
+            self->stats.color_transactions++;
+            self->stats.color_bytes += len;
+    }
+}
+
+
+// Send up to 2 colors, converted to the panel format on the stack.
+STATIC void write_pixels(mp_lcd_rm67162_obj_t *self, const uint16_t *colors, int n) {
+    if (self->convert) {
+        uint8_t buf[6];
+        self->convert(buf, colors, n);
+        write_color(self, buf, n * 3);
+    } else {
+        write_color(self, colors, n * 2);
     }
 }
 
@@ -71,7 +249,24 @@ STATIC void write_color(mp_lcd_rm67162_obj_t *self, const void *buf, int len) {
 STATIC void write_spi(mp_lcd_rm67162_obj_t *self, int cmd, const void *buf, int len) {
     if (self->lcd_panel_p) {
             self->lcd_panel_p->tx_param(self->bus_obj, cmd, buf, len);
+            self->stats.param_transactions++;
+            self->stats.param_bytes += len;
+    }
+}
+
+
+STATIC void wait_bus(mp_lcd_rm67162_obj_t *self) {
+    if (self->lcd_panel_p && self->lcd_panel_p->wait) {
+            self->lcd_panel_p->wait(self->bus_obj);
+    }
+}
+
+
+STATIC bool bus_busy(mp_lcd_rm67162_obj_t *self) {
+    if (self->lcd_panel_p && self->lcd_panel_p->busy) {
+            return self->lcd_panel_p->busy(self->bus_obj);
     }
+    return false;
 }
 
 
@@ -89,6 +284,29 @@ STATIC void frame_buffer_alloc(mp_lcd_rm67162_obj_t *self, int len) {
         mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Failed to allocate DMA'able framebuffer."));
     }
     memset(self->frame_buffer, 0, self->frame_buffer_size);
+    // the pixel format is not known yet, the first fill sets it up
+    self->frame_buffer_color = 0;
+    self->frame_buffer_filled = 0;
+}
+
+
+// the native resolution is configured on the bus
+STATIC void get_bus_size(mp_lcd_rm67162_obj_t *self) {
+#if USE_ESP_LCD
+    if (mp_obj_is_type(MP_OBJ_FROM_PTR(self->bus_obj), &mp_lcd_qspi_panel_type)) {
+        self->width = ((mp_lcd_qspi_panel_obj_t *)self->bus_obj)->width;
+        self->height = ((mp_lcd_qspi_panel_obj_t *)self->bus_obj)->height;
+        return;
+    }
+#endif
+#if EMULATED_LCD_SUPPORTED
+    if (mp_obj_is_type(MP_OBJ_FROM_PTR(self->bus_obj), &mp_lcd_emulated_panel_type)) {
+        self->width = ((mp_lcd_emulated_panel_obj_t *)self->bus_obj)->width;
+        self->height = ((mp_lcd_emulated_panel_obj_t *)self->bus_obj)->height;
+        return;
+    }
+#endif
+    mp_raise_TypeError(MP_ERROR_TEXT("unsupported bus"));
 }
 
 
@@ -105,6 +323,12 @@ STATIC void set_rotation(mp_lcd_rm67162_obj_t *self, uint8_t rotation)
     self->max_height_value = self->height - 1;
     self->x_gap = self->rotations[rotation].colstart;
     self->y_gap = self->rotations[rotation].rowstart;
+
+    // the shadow is laid out in the new orientation from now on
+    if (self->shadow) {
+        self->dirty_rects[0] = (rm67162_rect_t) { 0, 0, self->max_width_value, self->max_height_value };
+        self->dirty_count = 1;
+    }
 }
 
 
@@ -136,7 +360,9 @@ mp_obj_t mp_lcd_rm67162_make_new(const mp_obj_type_t *type,
  */        ARG_reset,
         ARG_reset_level,
         ARG_color_space,
-        ARG_bpp
+        ARG_bpp,
+        ARG_shadow,
+        ARG_te
     };
     static const mp_arg_t allowed_args[] = {
         { MP_QSTR_bus,            MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL}     },
@@ -145,6 +371,8 @@ mp_obj_t mp_lcd_rm67162_make_new(const mp_obj_type_t *type,
         { MP_QSTR_reset_level,    MP_ARG_BOOL | MP_ARG_KW_ONLY, {.u_bool = false}          },
         { MP_QSTR_color_space,    MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = COLOR_SPACE_RGB} },
         { MP_QSTR_bpp,            MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 16}              },
+        { MP_QSTR_shadow,         MP_ARG_BOOL | MP_ARG_KW_ONLY, {.u_bool = false}          },
+        { MP_QSTR_te,             MP_ARG_OBJ | MP_ARG_KW_ONLY,  {.u_obj = MP_OBJ_NULL}     },
     };
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all_kw_array(
@@ -168,22 +396,45 @@ mp_obj_t mp_lcd_rm67162_make_new(const mp_obj_type_t *type,
 #endif
 
     // self->max_width_value etc will be initialized in the rotation later.
-    self->width = ((mp_lcd_qspi_panel_obj_t *)self->bus_obj)->width;
-    self->height = ((mp_lcd_qspi_panel_obj_t *)self->bus_obj)->height;
+    get_bus_size(self);
 
-    // 2 bytes for each pixel. so maximum will be width * height * 2
-    frame_buffer_alloc(self, self->width * self->height * 2);
+    frame_buffer_alloc(self, RM67162_FRAME_BUFFER_SIZE);
 
     self->reset       = args[ARG_reset].u_obj;
     self->reset_level = args[ARG_reset_level].u_bool;
     self->color_space = args[ARG_color_space].u_int;
     self->bpp         = args[ARG_bpp].u_int;
+    self->window_valid = false;
     //mp_get_buffer_raise(args[ARG_buf].u_obj, &self->frame_buffer, MP_BUFFER_RW);
 
     // reset
     if (self->reset != MP_OBJ_NULL) {
+#if USE_ESP_LCD
         mp_hal_pin_obj_t reset_pin = mp_hal_get_pin_obj(self->reset);
         mp_hal_pin_output(reset_pin);
+#else
+        mp_raise_ValueError(MP_ERROR_TEXT("reset pin not supported"));
+#endif
+    }
+
+    self->te = args[ARG_te].u_obj;
+    self->te_edge = NULL;
+    self->te_enabled = false;
+    memset(&self->stats, 0, sizeof(self->stats));
+    self->frame_us = 0;
+    self->flag_type = MP_OBJ_NULL;
+    self->glyph_cache = NULL;
+    self->text_buffer = NULL;
+    self->text_buffer_size = 0;
+    self->decode_buffer = NULL;
+    if (self->te != MP_OBJ_NULL) {
+#if USE_ESP_LCD
+        mp_hal_pin_obj_t te_pin = mp_hal_get_pin_obj(self->te);
+        mp_hal_pin_input(te_pin);
+        self->te_edge = hal_lcd_te_attach(self->te);
+#else
+        mp_raise_ValueError(MP_ERROR_TEXT("te pin not supported"));
+#endif
     }
 
     switch (self->color_space) {
@@ -204,22 +455,39 @@ mp_obj_t mp_lcd_rm67162_make_new(const mp_obj_type_t *type,
         case 16:
             self->colmod_cal = 0x75;
             self->fb_bpp = 16;
+            self->pixel_format = PIXEL_FORMAT_RGB565_SWAPPED;
         break;
 
         case 18:
             self->colmod_cal = 0x76;
             self->fb_bpp = 24;
+            self->pixel_format = PIXEL_FORMAT_RGB666;
         break;
 
         case 24:
             self->colmod_cal = 0x77;
             self->fb_bpp = 24;
+            self->pixel_format = PIXEL_FORMAT_RGB888;
         break;
 
         default:
             mp_raise_ValueError(MP_ERROR_TEXT("unsupported pixel width"));
         break;
     }
+    self->pixel_bytes = lcd_panel_format_bytes(self->pixel_format);
+    self->convert = lcd_panel_convert_get(PIXEL_FORMAT_RGB565_SWAPPED, self->pixel_format);
+
+    self->shadow = NULL;
+    self->dirty_count = 0;
+    if (args[ARG_shadow].u_bool) {
+        // same amount of pixels in every rotation, on boards with SPIRAM the
+        // gc heap and so the shadow buffer is placed in PSRAM.
+        self->shadow = gc_alloc(self->width * self->height * 2, 0);
+        if (self->shadow == NULL) {
+            mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Failed to allocate shadow buffer."));
+        }
+        memset(self->shadow, 0, self->width * self->height * 2);
+    }
 
     bzero(&self->rotations, sizeof(self->rotations));
     if ((self->width == 240 && self->height == 536) || \
@@ -248,14 +516,44 @@ STATIC mp_obj_t mp_lcd_rm67162_deinit(mp_obj_t self_in)
 {
     mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(self_in);
 
+    // the framebuffer may still be on the wire in queued mode
+    wait_bus(self);
     if (self->lcd_panel_p) {
         self->lcd_panel_p->deinit(self->bus_obj);
     }
 
+#if USE_ESP_LCD
+    if (self->te_edge) {
+        hal_lcd_te_detach(self->te, self->te_edge);
+        self->te_edge = NULL;
+    }
+#endif
+
     gc_free(self->frame_buffer);
     self->frame_buffer = NULL;
     self->frame_buffer_size = 0;
 
+    if (self->shadow) {
+        gc_free(self->shadow);
+        self->shadow = NULL;
+        self->dirty_count = 0;
+    }
+
+    if (self->text_buffer) {
+        gc_free(self->text_buffer);
+        self->text_buffer = NULL;
+        self->text_buffer_size = 0;
+    }
+    if (self->decode_buffer) {
+        gc_free(self->decode_buffer);
+        self->decode_buffer = NULL;
+    }
+    if (self->glyph_cache) {
+        lcd_glyph_cache_clear(self->glyph_cache);
+        m_del_obj(lcd_glyph_cache_t, self->glyph_cache);
+        self->glyph_cache = NULL;
+    }
+
     // m_del_obj(mp_lcd_rm67162_obj_t, self); 
     return mp_const_none;
 }
@@ -266,15 +564,20 @@ STATIC mp_obj_t mp_lcd_rm67162_reset(mp_obj_t self_in)
 {
     mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(self_in);
 
+    wait_bus(self);
+#if USE_ESP_LCD
     if (self->reset != MP_OBJ_NULL) {
         mp_hal_pin_obj_t reset_pin = mp_hal_get_pin_obj(self->reset);
         mp_hal_pin_write(reset_pin, self->reset_level);
         mp_hal_delay_us(300 * 1000);
         mp_hal_pin_write(reset_pin, !self->reset_level);
         mp_hal_delay_us(200 * 1000);
-    } else {
+    } else
+#endif
+    {
         write_spi(self, LCD_CMD_SWRESET, NULL, 0);
     }
+    self->window_valid = false;
 
     return mp_const_none;
 }
@@ -287,6 +590,7 @@ STATIC mp_obj_t mp_lcd_rm67162_init(mp_obj_t self_in)
 
     write_spi(self, LCD_CMD_SLPOUT, NULL, 0);     //sleep out
     mp_hal_delay_us(100 * 1000);
+    self->window_valid = false;
 
     write_spi(self, LCD_CMD_MADCTL, (uint8_t[]) {
         self->madctl_val,
@@ -315,6 +619,8 @@ STATIC mp_obj_t mp_lcd_rm67162_send_cmd(size_t n_args, const mp_obj_t *args_in)
     uint8_t c_bits = mp_obj_get_int(args_in[2]);
     uint8_t len = mp_obj_get_int(args_in[3]);
 
+    // the command may change the window behind our back
+    self->window_valid = false;
     if (len <= 0) {
         write_spi(self, cmd, NULL, 0);
     } else {
@@ -345,47 +651,260 @@ STATIC mp_obj_t mp_lcd_rm67162_colorRGB(size_t n_args, const mp_obj_t *args_in)
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_colorRGB_obj, 4, 4, mp_lcd_rm67162_colorRGB);
 
 
-STATIC void set_area(mp_lcd_rm67162_obj_t *self, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+// Only sends LCD_CMD_CASET/LCD_CMD_RASET when the window actually changed,
+// the memory write command itself is issued by the bus with the pixel data.
+STATIC void set_window(mp_lcd_rm67162_obj_t *self, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+    LCD_TRACE_BEGIN(MP_QSTR_set_window, LCD_TRACE_DRIVER);
+    if (!self->window_valid || self->window_x0 != x0 || self->window_x1 != x1) {
+        uint8_t bufx[4] = {
+            ((x0 >> 8) & 0x03),
+            (x0 & 0xFF),
+            ((x1 >> 8) & 0x03),
+            (x1 & 0xFF)};
+        write_spi(self, LCD_CMD_CASET, bufx, 4);
+    }
+    if (!self->window_valid || self->window_y0 != y0 || self->window_y1 != y1) {
+        uint8_t bufy[4] = {
+            ((y0 >> 8) & 0x03),
+            (y0 & 0xFF),
+            ((y1 >> 8) & 0x03),
+            (y1 & 0xFF)};
+        write_spi(self, LCD_CMD_RASET, bufy, 4);
+    }
+    self->window_x0 = x0;
+    self->window_y0 = y0;
+    self->window_x1 = x1;
+    self->window_y1 = y1;
+    self->window_valid = true;
+    LCD_TRACE_END(MP_QSTR_set_window, LCD_TRACE_DRIVER, 0);
+}
+
+
+// returns false if the area is outside of the screen and nothing should be sent.
+STATIC bool set_area(mp_lcd_rm67162_obj_t *self, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
     if (x0 > x1 || x1 > self->max_width_value) {
-        return;
+        return false;
     }
     if (y0 > y1 || y1 > self->max_height_value) {
-        return;
+        return false;
     }
 
-    uint8_t bufx[4] = {
-        ((x0 >> 8) & 0x03),
-        (x0 & 0xFF),
-        ((x1 >> 8) & 0x03),
-        (x1 & 0xFF)};
-    uint8_t bufy[4] = {
-        ((y0 >> 8) & 0x03),
-        (y0 & 0xFF),
-        ((y1 >> 8) & 0x03),
-        (y1 & 0xFF)};
-    write_spi(self, LCD_CMD_CASET, bufx, 4);
-    write_spi(self, LCD_CMD_RASET, bufy, 4);
-    write_spi(self, LCD_CMD_RAMWR, NULL, 0);
+    set_window(self, x0, y0, x1, y1);
+    return true;
 }
 
 // this function is extremely dangerous and should be called with a lot of care.
 STATIC void fill_color_buffer(mp_lcd_rm67162_obj_t *self, uint32_t color, int len /*in pixel*/) {
-    uint32_t *buffer = (uint32_t *)self->frame_buffer;
-    color = (color << 16) | color;
-    // this ensures that the framebuffer is overfilled rather than unfilled.
-    // also because the framebuffer_size is always even, you should not worry
-    // about exceeding it.
-    size_t size = (len + 1) / 2; 
-    while (size--) {
-        *buffer++ = color;
+    // only as much as fits is filled, longer runs repeat the buffer. With 3
+    // bytes per pixel it holds a multiple of 4 pixels, so every repeat starts
+    // word aligned.
+    int capacity = self->frame_buffer_size / 2;
+    if (self->pixel_bytes == 3) {
+        capacity = self->frame_buffer_size / 12 * 4;
+    }
+    int fill = MIN(len, capacity);
+
+    // runs of the same color reuse what is already in the framebuffer.
+    if (color != self->frame_buffer_color || (size_t)fill > self->frame_buffer_filled) {
+        // the previous fill may still be reading the framebuffer in queued mode.
+        wait_bus(self);
+        self->frame_buffer_color = color;
+
+        if (self->convert) {
+            // convert the color once and repeat its bytes
+            uint8_t *buffer = (uint8_t *)self->frame_buffer;
+            uint16_t color565 = color;
+            self->convert(buffer, &color565, 1);
+            size_t size = (fill + 3) & ~3;
+            self->frame_buffer_filled = size;
+            for (size_t i = 1; i < size; i++) {
+                memcpy(buffer + i * 3, buffer, 3);
+            }
+        } else {
+            uint32_t *buffer = (uint32_t *)self->frame_buffer;
+            color = (color << 16) | color;
+            // this ensures that the framebuffer is overfilled rather than unfilled.
+            // also because the framebuffer_size is always even, you should not worry
+            // about exceeding it.
+            size_t size = (fill + 1) / 2;
+            self->frame_buffer_filled = size * 2;
+            while (size--) {
+                *buffer++ = color;
+            }
+        }
+    }
+    if (len == fill) {
+        write_color(self, self->frame_buffer, len * self->pixel_bytes);
+    } else {
+        write_pattern(self, self->frame_buffer, fill * self->pixel_bytes, len * self->pixel_bytes);
+    }
+}
+
+
+STATIC uint32_t rect_area(const rm67162_rect_t *r) {
+    return (r->x1 - r->x0 + 1) * (r->y1 - r->y0 + 1);
+}
+
+
+STATIC void rect_union(rm67162_rect_t *r, const rm67162_rect_t *other) {
+    r->x0 = MIN(r->x0, other->x0);
+    r->y0 = MIN(r->y0, other->y0);
+    r->x1 = MAX(r->x1, other->x1);
+    r->y1 = MAX(r->y1, other->y1);
+}
+
+
+// overlapping or directly adjacent rects
+STATIC bool rect_touches(const rm67162_rect_t *a, const rm67162_rect_t *b) {
+    return a->x0 <= b->x1 + 1 && b->x0 <= a->x1 + 1 &&
+           a->y0 <= b->y1 + 1 && b->y0 <= a->y1 + 1;
+}
+
+
+STATIC void mark_dirty(mp_lcd_rm67162_obj_t *self, int x0, int y0, int x1, int y1) {
+    rm67162_rect_t rect = { x0, y0, x1, y1 };
+
+    // grow the rect by everything it touches, until nothing touches it anymore
+    for (int i = 0; i < self->dirty_count; i++) {
+        if (rect_touches(&rect, &self->dirty_rects[i])) {
+            rect_union(&rect, &self->dirty_rects[i]);
+            self->dirty_rects[i] = self->dirty_rects[--self->dirty_count];
+            i = -1;
+        }
+    }
+
+    if (self->dirty_count == RM67162_DIRTY_RECTS) {
+        // no free slot, merge with the rect that grows the least
+        int best = 0;
+        uint32_t best_growth = UINT32_MAX;
+        for (int i = 0; i < self->dirty_count; i++) {
+            rm67162_rect_t merged = self->dirty_rects[i];
+            rect_union(&merged, &rect);
+            uint32_t growth = rect_area(&merged) - rect_area(&self->dirty_rects[i]);
+            if (growth < best_growth) {
+                best = i;
+                best_growth = growth;
+            }
+        }
+        rect_union(&rect, &self->dirty_rects[best]);
+        self->dirty_rects[best] = self->dirty_rects[--self->dirty_count];
+        // the merged rect may touch others now
+        mark_dirty(self, rect.x0, rect.y0, rect.x1, rect.y1);
+        return;
+    }
+    self->dirty_rects[self->dirty_count++] = rect;
+}
+
+
+STATIC void shadow_fill(mp_lcd_rm67162_obj_t *self, int x0, int y0, int x1, int y1, uint16_t color) {
+    for (int y = y0; y <= y1; y++) {
+        uint16_t *p = self->shadow + y * self->width + x0;
+        for (int x = x0; x <= x1; x++) {
+            *p++ = color;
+        }
+    }
+    mark_dirty(self, x0, y0, x1, y1);
+}
+
+
+// Send w x h pixels to the window starting at (x, y). Rows are stride bytes
+// apart in src, they are converted from RGB565 (or just copied, if convert
+// is NULL) into the frame buffer and sent band by band.
+STATIC void send_converted(mp_lcd_rm67162_obj_t *self, int x, int y, int w, int h,
+                           const uint8_t *src, size_t stride, lcd_panel_convert_t convert) {
+    int line = w * self->pixel_bytes;
+    int band = self->frame_buffer_size / line;
+    if (band == 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("area too wide"));
+    }
+
+    for (int row = 0; row < h; row += band) {
+        int rows = MIN(band, h - row);
+        wait_bus(self);
+        uint8_t *out = (uint8_t *)self->frame_buffer;
+        for (int i = row; i < row + rows; i++) {
+            const uint8_t *in = src + i * stride;
+            if (convert) {
+                convert(out, (const uint16_t *)in, w);
+            } else {
+                memcpy(out, in, line);
+            }
+            out += line;
+        }
+        // the fill color cache is gone
+        self->frame_buffer_filled = 0;
+        set_window(self, x, y + row, x + w - 1, y + row + rows - 1);
+        write_color(self, self->frame_buffer, line * rows);
     }
-    write_color(self, self->frame_buffer, len * 2);
+}
+
+
+// Send one area of the shadow to the panel. It is copied into the frame
+// buffer band by band, even when full width rows are contiguous, so drawing
+// into the shadow never races a queued transfer still reading it.
+STATIC void shadow_flush(mp_lcd_rm67162_obj_t *self, const rm67162_rect_t *rect) {
+    int w = rect->x1 - rect->x0 + 1;
+
+    send_converted(self, rect->x0 + self->x_gap, rect->y0 + self->y_gap, w, rect->y1 - rect->y0 + 1,
+                   (const uint8_t *)(self->shadow + rect->y0 * self->width + rect->x0),
+                   self->width * 2, self->convert);
+}
+
+
+STATIC void show(mp_lcd_rm67162_obj_t *self) {
+    for (int i = 0; i < self->dirty_count; i++) {
+        shadow_flush(self, &self->dirty_rects[i]);
+    }
+    self->dirty_count = 0;
 }
 
 
 STATIC void draw_pixel(mp_lcd_rm67162_obj_t *self, uint16_t x, uint16_t y, uint16_t color) {
-    set_area(self, x, y, x, y);
-    write_color(self, (uint8_t *) &color, 2);
+    if (self->shadow) {
+        if (x <= self->max_width_value && y <= self->max_height_value) {
+            self->shadow[y * self->width + x] = color;
+            mark_dirty(self, x, y, x, y);
+        }
+        return;
+    }
+    if (set_area(self, x, y, x, y)) {
+        write_pixels(self, &color, 1);
+    }
+}
+
+
+// Fill the area from (x0, y0) to (x1, y1), both included, clipped to the screen.
+STATIC void fill_area(mp_lcd_rm67162_obj_t *self, int x0, int y0, int x1, int y1, uint16_t color) {
+    if (x0 < 0) {
+        x0 = 0;
+    }
+    if (y0 < 0) {
+        y0 = 0;
+    }
+    if (x1 > self->max_width_value) {
+        x1 = self->max_width_value;
+    }
+    if (y1 > self->max_height_value) {
+        y1 = self->max_height_value;
+    }
+    if (x0 > x1 || y0 > y1) {
+        return;
+    }
+    if (self->shadow) {
+        shadow_fill(self, x0, y0, x1, y1, color);
+        return;
+    }
+
+    set_area(self, x0, y0, x1, y1);
+    int len = (x1 - x0 + 1) * (y1 - y0 + 1);
+    if (len * self->pixel_bytes <= 4) {
+        // short runs are sent from the stack, the bus copies them into the
+        // transaction, so there is no need to wait for the fill buffer.
+        uint16_t buf[2] = { color, color };
+        write_pixels(self, buf, len);
+    } else {
+        fill_color_buffer(self, color, len);
+    }
 }
 
 
@@ -395,7 +914,9 @@ STATIC mp_obj_t mp_lcd_rm67162_pixel(size_t n_args, const mp_obj_t *args_in) {
     uint16_t y = mp_obj_get_int(args_in[2]);
     uint16_t color = mp_obj_get_int(args_in[3]);
 
+    STATS_START(RM67162_STAT_PIXEL);
     draw_pixel(self, x, y, color);
+    STATS_STOP(self, RM67162_STAT_PIXEL);
 
     return mp_const_none;
 }
@@ -404,8 +925,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_pixel_obj, 4, 4, mp_lc
 
 // this can be replaced by fill_rect
 STATIC void fast_fill(mp_lcd_rm67162_obj_t *self, uint16_t color) {
-    set_area(self, 0, 0, self->max_width_value, self->max_height_value);
-    fill_color_buffer(self, color, self->frame_buffer_size / 2);
+    fill_area(self, 0, 0, self->max_width_value, self->max_height_value, color);
 }
 
 
@@ -413,7 +933,9 @@ STATIC mp_obj_t mp_lcd_rm67162_fill(size_t n_args, const mp_obj_t *args_in) {
     mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
     uint16_t color = mp_obj_get_int(args_in[1]);
 
+    STATS_START(RM67162_STAT_FILL);
     fast_fill(self, color);
+    STATS_STOP(self, RM67162_STAT_FILL);
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_fill_obj, 2, 2, mp_lcd_rm67162_fill);
@@ -430,15 +952,7 @@ STATIC void fast_hline(mp_lcd_rm67162_obj_t *self, int x, int y, uint16_t l, uin
     if (l == 1) {
         draw_pixel(self, x, y, color);
     } else {
-        if (x < 0) {
-            l += x;
-            x = 0;
-        }
-        if (x + l > self->max_width_value) {
-            l = self->max_width_value - x;
-        }
-        set_area(self, x, y, x + l, y);
-        fill_color_buffer(self, color, l + 1);
+        fill_area(self, x, y, x + l, y, color);
     }
 }
 
@@ -454,15 +968,7 @@ STATIC void fast_vline(mp_lcd_rm67162_obj_t *self, int x, int y, uint16_t l, uin
     if (l == 1) {
         draw_pixel(self, x, y, color);
     } else {
-        if (y < 0) {
-            l += y;
-            y = 0;
-        }
-        if (y + l > self->max_height_value) {
-            l = self->max_height_value - y;
-        }
-        set_area(self, x, y, x, y + l);
-        fill_color_buffer(self, color, l + 1);
+        fill_area(self, x, y, x, y + l, color);
     }
 }
 
@@ -473,7 +979,9 @@ STATIC mp_obj_t mp_lcd_rm67162_hline(size_t n_args, const mp_obj_t *args_in) {
     uint16_t l = mp_obj_get_int(args_in[3]);
     uint16_t color = mp_obj_get_int(args_in[4]);
 
+    STATS_START(RM67162_STAT_HLINE);
     fast_hline(self, x, y, l, color);
+    STATS_STOP(self, RM67162_STAT_HLINE);
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_hline_obj, 5, 5, mp_lcd_rm67162_hline);
@@ -486,12 +994,81 @@ STATIC mp_obj_t mp_lcd_rm67162_vline(size_t n_args, const mp_obj_t *args_in) {
     uint16_t l = mp_obj_get_int(args_in[3]);
     uint16_t color = mp_obj_get_int(args_in[4]);
 
+    STATS_START(RM67162_STAT_VLINE);
     fast_vline(self, x, y, l, color);
+    STATS_STOP(self, RM67162_STAT_VLINE);
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_vline_obj, 5, 5, mp_lcd_rm67162_vline);
 
 
+// Bresenham from (x0, y0) to (x1, y1), both included. The pixels of a line
+// form runs along its major axis, one per step on the minor axis, and every
+// run goes out as one window instead of pixel by pixel. fill_area() clips.
+STATIC void draw_line(mp_lcd_rm67162_obj_t *self, int x0, int y0, int x1, int y1, uint16_t color) {
+    int dx = abs(x1 - x0);
+    int dy = abs(y1 - y0);
+    int sx = (x0 < x1) ? 1 : -1;
+    int sy = (y0 < y1) ? 1 : -1;
+
+    if ((x0 < 0 && x1 < 0) || (y0 < 0 && y1 < 0) ||
+        (x0 > self->max_width_value && x1 > self->max_width_value) ||
+        (y0 > self->max_height_value && y1 > self->max_height_value)) {
+        return;
+    }
+
+    if (dx >= dy) {
+        int err = dx / 2;
+        int start = x0;
+        for (int x = x0, y = y0;; x += sx) {
+            if (x == x1) {
+                fill_area(self, MIN(start, x), y, MAX(start, x), y, color);
+                break;
+            }
+            err -= dy;
+            if (err < 0) {
+                fill_area(self, MIN(start, x), y, MAX(start, x), y, color);
+                y += sy;
+                err += dx;
+                start = x + sx;
+            }
+        }
+    } else {
+        int err = dy / 2;
+        int start = y0;
+        for (int x = x0, y = y0;; y += sy) {
+            if (y == y1) {
+                fill_area(self, x, MIN(start, y), x, MAX(start, y), color);
+                break;
+            }
+            err -= dx;
+            if (err < 0) {
+                fill_area(self, x, MIN(start, y), x, MAX(start, y), color);
+                x += sx;
+                err += dy;
+                start = y + sy;
+            }
+        }
+    }
+}
+
+
+STATIC mp_obj_t mp_lcd_rm67162_line(size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    int x0 = mp_obj_get_int(args_in[1]);
+    int y0 = mp_obj_get_int(args_in[2]);
+    int x1 = mp_obj_get_int(args_in[3]);
+    int y1 = mp_obj_get_int(args_in[4]);
+    uint16_t color = mp_obj_get_int(args_in[5]);
+
+    STATS_START(RM67162_STAT_LINE);
+    draw_line(self, x0, y0, x1, y1, color);
+    STATS_STOP(self, RM67162_STAT_LINE);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_line_obj, 6, 6, mp_lcd_rm67162_line);
+
+
 
 STATIC void rect(mp_lcd_rm67162_obj_t *self, uint16_t x, uint16_t y, uint16_t w, uint16_t l, uint16_t color) {
     fast_hline(self, x, y, w, color);
@@ -509,15 +1086,16 @@ STATIC mp_obj_t mp_lcd_rm67162_rect(size_t n_args, const mp_obj_t *args_in) {
     uint16_t l = mp_obj_get_int(args_in[4]);
     uint16_t color = mp_obj_get_int(args_in[5]);
 
+    STATS_START(RM67162_STAT_RECT);
     rect(self, x, y, w, l, color);
+    STATS_STOP(self, RM67162_STAT_RECT);
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_rect_obj, 6, 6, mp_lcd_rm67162_rect);
 
 
 STATIC void fill_rect(mp_lcd_rm67162_obj_t *self, uint16_t x, uint16_t y, uint16_t w, uint16_t l, uint16_t color) {
-    set_area(self, x, y, x + w - 1, y + l - 1);
-    fill_color_buffer(self, color, w * l);
+    fill_area(self, x, y, x + w - 1, y + l - 1, color);
 }
 
 
@@ -529,122 +1107,1318 @@ STATIC mp_obj_t mp_lcd_rm67162_fill_rect(size_t n_args, const mp_obj_t *args_in)
     uint16_t l = mp_obj_get_int(args_in[4]);
     uint16_t color = mp_obj_get_int(args_in[5]);
 
+    STATS_START(RM67162_STAT_FILL_RECT);
     fill_rect(self, x, y, w, l, color);
+    STATS_STOP(self, RM67162_STAT_FILL_RECT);
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_fill_rect_obj, 6, 6, mp_lcd_rm67162_fill_rect);
 
-/*
-Similar to: https://en.wikipedia.org/wiki/Midpoint_circle_algorithm
-*/
-STATIC void circle(mp_lcd_rm67162_obj_t *self, int xm, int ym, int r, uint16_t color) {
-    int x = 0;
-    int y = r;
-    int p = 1 - r;
 
-    while (x <= y) {
-        draw_pixel(self, xm + x, ym + y, color);
-        draw_pixel(self, xm + x, ym - y, color);
-        draw_pixel(self, xm - x, ym + y, color);
-        draw_pixel(self, xm - x, ym - y, color);
-        draw_pixel(self, xm + y, ym + x, color);
-        draw_pixel(self, xm + y, ym - x, color);
-        draw_pixel(self, xm - y, ym + x, color);
-        draw_pixel(self, xm - y, ym - x, color);
+// Filled shapes are handed over row by row, from top to bottom. Rows with the
+// same span are merged into one rectangle, so e.g. the middle of a circle or
+// the straight part of a rounded rectangle is a single window.
+typedef struct _span_run_t {
+    bool pending;
+    int x0;
+    int x1;
+    int y0;
+    int y1;
+    uint16_t color;
+} span_run_t;
 
-        if (p < 0) {
-            p += 2 * x + 3;
-        } else {
-            p += 2 * (x - y) + 5;
-            y -= 1;
-        }
-        x += 1;
+
+STATIC void span_begin(span_run_t *run, uint16_t color) {
+    run->pending = false;
+    run->color = color;
+}
+
+
+STATIC void span_end(mp_lcd_rm67162_obj_t *self, span_run_t *run) {
+    if (run->pending) {
+        fill_area(self, run->x0, run->y0, run->x1, run->y1, run->color);
+        run->pending = false;
     }
 }
 
 
-STATIC mp_obj_t mp_lcd_rm67162_circle(size_t n_args, const mp_obj_t *args_in) {
-    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
-    int xm = mp_obj_get_int(args_in[1]);
-    int ym = mp_obj_get_int(args_in[2]);
-    int r = mp_obj_get_int(args_in[3]);
-    uint16_t color = mp_obj_get_int(args_in[4]);
+STATIC void span_add(mp_lcd_rm67162_obj_t *self, span_run_t *run, int y, int x0, int x1) {
+    if (run->pending && y == run->y1 + 1 && x0 == run->x0 && x1 == run->x1) {
+        run->y1 = y;
+        return;
+    }
+    span_end(self, run);
+    run->pending = true;
+    run->x0 = x0;
+    run->x1 = x1;
+    run->y0 = y;
+    run->y1 = y;
+}
 
-    circle(self, xm, ym, r, color);
-    return mp_const_none;
+
+// Rectangles drawn one after the other. One continuing the previous rect of
+// the same color straight down or to the right is merged into it.
+STATIC void span_add_rect(mp_lcd_rm67162_obj_t *self, span_run_t *run, int x0, int y0, int x1, int y1, uint16_t color) {
+    if (run->pending && color == run->color &&
+        ((x0 == run->x0 && x1 == run->x1 && y0 == run->y1 + 1) ||
+         (y0 == run->y0 && y1 == run->y1 && x0 == run->x1 + 1))) {
+        run->x1 = x1;
+        run->y1 = y1;
+        return;
+    }
+    span_end(self, run);
+    run->pending = true;
+    run->color = color;
+    run->x0 = x0;
+    run->x1 = x1;
+    run->y0 = y0;
+    run->y1 = y1;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_circle_obj, 5, 5, mp_lcd_rm67162_circle);
 
 
-STATIC void fill_circle(mp_lcd_rm67162_obj_t *self, int xm, int ym, int r, uint16_t color) {
-    int x = 0;
-    int y = r;
-    int p = 1 - r;
+/*----------------------------------------------------------------------------------------------------
+Batched primitives. They take packed int16 records, e.g. array('h'), with the color as the last
+field, or without it when a single color is passed as the second argument.
+-----------------------------------------------------------------------------------------------------*/
 
-    while (x <= y) {
-        fast_vline(self, xm + x, ym - y, 2 * y, color);
-        fast_vline(self, xm - x, ym - y, 2 * y, color);
-        fast_vline(self, xm + y, ym - x, 2 * x, color);
-        fast_vline(self, xm - y, ym - x, 2 * x, color);
 
-        if (p < 0) {
-            p += 2 * x + 3;
-        } else {
-            p += 2 * (x - y) + 5;
-            y -= 1;
+STATIC const int16_t *get_records(mp_obj_t buf_in, size_t fields, size_t *count) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_READ);
+    if (bufinfo.len % (fields * 2) != 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("buffer length is not a multiple of the record size"));
+    }
+    // the fields are read as int16, which faults at an odd address on the esp32
+    if (((uintptr_t)bufinfo.buf & 1) != 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("buffer not aligned to 2 bytes"));
+    }
+    *count = bufinfo.len / (fields * 2);
+    return bufinfo.buf;
+}
+
+
+STATIC int compare_keys(const void *a, const void *b) {
+    uint64_t ka = *(const uint64_t *)a;
+    uint64_t kb = *(const uint64_t *)b;
+    return (ka > kb) - (ka < kb);
+}
+
+
+// The pixels are sorted by row and column, so neighbours of the same color
+// go out as one run. When a position shows up more than once, the record
+// that comes last wins, just like drawing them one by one.
+STATIC mp_obj_t mp_lcd_rm67162_pixels(size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    bool one_color = n_args == 3;
+    uint16_t color = one_color ? mp_obj_get_int(args_in[2]) : 0;
+    size_t fields = one_color ? 2 : 3;
+    size_t count;
+    const int16_t *rec = get_records(args_in[1], fields, &count);
+    STATS_START(RM67162_STAT_PIXELS);
+
+    // y, x and the index of the record, pixels off screen are dropped here
+    uint64_t *keys = m_new(uint64_t, count);
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        int x = rec[i * fields];
+        int y = rec[i * fields + 1];
+        if (x >= 0 && y >= 0 && x <= self->max_width_value && y <= self->max_height_value) {
+            keys[n++] = ((uint64_t)y << 48) | ((uint64_t)x << 32) | i;
         }
-        x += 1;
     }
+    qsort(keys, n, sizeof(keys[0]), compare_keys);
+
+    int run_x = 0, run_y = -1, run_end = 0;
+    uint16_t run_color = 0;
+    for (size_t i = 0; i < n; i++) {
+        // skip to the last record of a position
+        if (i + 1 < n && (keys[i] >> 32) == (keys[i + 1] >> 32)) {
+            continue;
+        }
+        int x = (keys[i] >> 32) & 0xFFFF;
+        int y = keys[i] >> 48;
+        uint16_t c = one_color ? color : rec[(uint32_t)keys[i] * fields + 2];
+
+        if (y == run_y && x == run_end + 1 && c == run_color) {
+            run_end = x;
+            continue;
+        }
+        if (run_y >= 0) {
+            fill_area(self, run_x, run_y, run_end, run_y, run_color);
+        }
+        run_x = run_end = x;
+        run_y = y;
+        run_color = c;
+    }
+    if (run_y >= 0) {
+        fill_area(self, run_x, run_y, run_end, run_y, run_color);
+    }
+
+    m_del(uint64_t, keys, count);
+    STATS_STOP(self, RM67162_STAT_PIXELS);
+    return mp_const_none;
 }
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_pixels_obj, 2, 3, mp_lcd_rm67162_pixels);
 
 
-STATIC mp_obj_t mp_lcd_rm67162_fill_circle(size_t n_args, const mp_obj_t *args_in) {
+// Records are (x, y, l[, color]) like hline(). They are drawn in order, a
+// line continuing the previous one in the same row and color is merged.
+STATIC mp_obj_t mp_lcd_rm67162_hlines(size_t n_args, const mp_obj_t *args_in) {
     mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
-    int xm = mp_obj_get_int(args_in[1]);
-    int ym = mp_obj_get_int(args_in[2]);
-    int r = mp_obj_get_int(args_in[3]);
-    uint16_t color = mp_obj_get_int(args_in[4]);
+    bool one_color = n_args == 3;
+    uint16_t color = one_color ? mp_obj_get_int(args_in[2]) : 0;
+    size_t fields = one_color ? 3 : 4;
+    size_t count;
+    const int16_t *rec = get_records(args_in[1], fields, &count);
+    STATS_START(RM67162_STAT_HLINES);
+
+    int run_x0 = 0, run_x1 = 0, run_y = -1;
+    uint16_t run_color = 0;
+    for (size_t i = 0; i < count; i++) {
+        const int16_t *r = rec + i * fields;
+        int x = r[0];
+        int y = r[1];
+        uint16_t l = r[2];
+        uint16_t c = one_color ? color : r[3];
+        if (y < 0 || l == 0) {
+            continue;
+        }
+        // same length rules as hline()
+        int x1 = (l == 1) ? x : x + l;
 
-    fill_circle(self, xm, ym, r, color);
+        if (y == run_y && c == run_color && x >= run_x0 && x <= run_x1 + 1) {
+            run_x1 = MAX(run_x1, x1);
+            continue;
+        }
+        if (run_y >= 0) {
+            fill_area(self, run_x0, run_y, run_x1, run_y, run_color);
+        }
+        run_x0 = x;
+        run_x1 = x1;
+        run_y = y;
+        run_color = c;
+    }
+    if (run_y >= 0) {
+        fill_area(self, run_x0, run_y, run_x1, run_y, run_color);
+    }
+
+    STATS_STOP(self, RM67162_STAT_HLINES);
     return mp_const_none;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_fill_circle_obj, 5, 5, mp_lcd_rm67162_fill_circle);
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_hlines_obj, 2, 3, mp_lcd_rm67162_hlines);
+
+
+// Records are (x, y, w, h[, color]), drawn in order. A rect continuing the
+// previous one of the same color straight down or to the right is merged.
+STATIC mp_obj_t mp_lcd_rm67162_fill_rects(size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    bool one_color = n_args == 3;
+    uint16_t color = one_color ? mp_obj_get_int(args_in[2]) : 0;
+    size_t fields = one_color ? 4 : 5;
+    size_t count;
+    const int16_t *rec = get_records(args_in[1], fields, &count);
+    STATS_START(RM67162_STAT_FILL_RECTS);
+
+    span_run_t run;
+    span_begin(&run, color);
+    for (size_t i = 0; i < count; i++) {
+        const int16_t *r = rec + i * fields;
+        if (r[2] <= 0 || r[3] <= 0) {
+            continue;
+        }
+        span_add_rect(self, &run, r[0], r[1], r[0] + r[2] - 1, r[1] + r[3] - 1, one_color ? color : r[4]);
+    }
+    span_end(self, &run);
 
+    STATS_STOP(self, RM67162_STAT_FILL_RECTS);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_fill_rects_obj, 2, 3, mp_lcd_rm67162_fill_rects);
 
 
-STATIC mp_obj_t mp_lcd_rm67162_bitmap(size_t n_args, const mp_obj_t *args_in) {
+// Records are (x, y) points, joined by lines in order.
+STATIC mp_obj_t mp_lcd_rm67162_polyline(size_t n_args, const mp_obj_t *args_in) {
     mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    uint16_t color = mp_obj_get_int(args_in[2]);
+    size_t count;
+    const int16_t *rec = get_records(args_in[1], 2, &count);
+    STATS_START(RM67162_STAT_POLYLINE);
 
-    int x_start = mp_obj_get_int(args_in[1]);
-    int y_start = mp_obj_get_int(args_in[2]);
-    int x_end   = mp_obj_get_int(args_in[3]);
-    int y_end   = mp_obj_get_int(args_in[4]);
+    if (count == 1) {
+        draw_line(self, rec[0], rec[1], rec[0], rec[1], color);
+    }
+    for (size_t i = 1; i < count; i++) {
+        const int16_t *r = rec + (i - 1) * 2;
+        draw_line(self, r[0], r[1], r[2], r[3], color);
+    }
 
-    x_start += self->x_gap;
-    x_end += self->x_gap;
-    y_start += self->y_gap;
-    y_end += self->y_gap;
+    STATS_STOP(self, RM67162_STAT_POLYLINE);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_polyline_obj, 3, 3, mp_lcd_rm67162_polyline);
 
-    mp_buffer_info_t bufinfo;
-    mp_get_buffer_raise(args_in[5], &bufinfo, MP_BUFFER_READ);
-    write_spi(self, LCD_CMD_CASET, (uint8_t[]) {
-        ((x_start >> 8) & 0x03),
-        (x_start & 0xFF),
-        (((x_end - 1) >> 8) & 0x03),
-        ((x_end - 1) & 0xFF),
-    }, 4);
-    write_spi(self, LCD_CMD_RASET, (uint8_t[]) {
-        ((y_start >> 8) & 0x03),
-        (y_start & 0xFF),
-        (((y_end - 1) >> 8) & 0x03),
-        ((y_end - 1) & 0xFF),
-    }, 4);
-    size_t len = ((x_end - x_start) * (y_end - y_start) * self->fb_bpp / 8);
-    self->lcd_panel_p->tx_color(self->bus_obj, LCD_CMD_RAMWR, bufinfo.buf, len);
 
+/*----------------------------------------------------------------------------------------------------
+Filled polygons. Every row is sampled at the pixel centers and a pixel is filled when its center is
+inside (even-odd rule), so shapes sharing an edge neither overlap nor leave a gap between them.
+-----------------------------------------------------------------------------------------------------*/
+
+
+// x is kept as 16.16 fixed point plus the remainder err / den, so it is the
+// exact crossing rounded down. Pixel centers lie on the 16.16 grid, so edges
+// through a center are decided exactly, whatever the slope.
+typedef struct _poly_edge_t {
+    int y0;      // first row the edge crosses
+    int y1;      // row after the last one
+    int32_t x;   // where it crosses the center of the current row, 16.16
+    int32_t dx;  // change of x from one row to the next, 16.16
+    int32_t err; // 0 <= err < den
+    int32_t derr;
+    int32_t den;
+} poly_edge_t;
+
+
+STATIC int64_t floor_div(int64_t a, int64_t b, int64_t *rem) {
+    int64_t q = a / b;
+    int64_t r = a % b;
+    if (r < 0) {
+        q--;
+        r += b;
+    }
+    *rem = r;
+    return q;
+}
+
+
+STATIC int compare_edges(const void *a, const void *b) {
+    return ((const poly_edge_t *)a)->y0 - ((const poly_edge_t *)b)->y0;
+}
+
+
+// Fill the polygon through count (x, y) points, the last one is joined to the
+// first. The edge table is sorted by first row and clipped to the rows of the
+// screen, the active edges are stepped from row to row. Rows with the same
+// span are merged into one window, spans are clipped by fill_area().
+STATIC void fill_polygon(mp_lcd_rm67162_obj_t *self, const int16_t *pts, size_t count, uint16_t color) {
+    if (count < 3) {
+        return;
+    }
+    int rows = self->max_height_value + 1;
+    poly_edge_t *edges = m_new(poly_edge_t, count);
+    poly_edge_t **active = m_new(poly_edge_t *, count);
+    int32_t *xs = m_new(int32_t, count);
+
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t j = (i + 1) % count;
+        int xa = pts[i * 2], ya = pts[i * 2 + 1];
+        int xb = pts[j * 2], yb = pts[j * 2 + 1];
+        if (ya == yb) {
+            // crosses no row center
+            continue;
+        }
+        if (ya > yb) {
+            int t = xa; xa = xb; xb = t;
+            t = ya; ya = yb; yb = t;
+        }
+        int y0 = MAX(ya, 0);
+        int y1 = MIN(yb, rows);
+        if (y0 >= y1) {
+            continue;
+        }
+        int64_t w = xb - xa;
+        int64_t h = yb - ya;
+        int64_t rem;
+        poly_edge_t *e = &edges[n++];
+        e->y0 = y0;
+        e->y1 = y1;
+        e->den = 2 * h;
+        // x(y) = xa + (y + 0.5 - ya) * w / h
+        e->x = (int64_t)xa * 65536 + floor_div((2 * (y0 - ya) + 1) * w * 65536, e->den, &rem);
+        e->err = rem;
+        // an edge over a single row is never stepped, and its slope may not fit
+        e->dx = 0;
+        e->derr = 0;
+        if (h > 1) {
+            e->dx = floor_div(2 * w * 65536, e->den, &rem);
+            e->derr = rem;
+        }
+    }
+    qsort(edges, n, sizeof(edges[0]), compare_edges);
+
+    span_run_t run;
+    span_begin(&run, color);
+    size_t next = 0;
+    size_t n_active = 0;
+    int y = n ? edges[0].y0 : rows;
+    while (y < rows && (n_active > 0 || next < n)) {
+        while (next < n && edges[next].y0 == y) {
+            active[n_active++] = &edges[next++];
+        }
+        if (n_active == 0) {
+            y = edges[next].y0;
+            continue;
+        }
+
+        // the order barely changes from row to row
+        for (size_t k = 0; k < n_active; k++) {
+            int32_t x = active[k]->x;
+            size_t m = k;
+            for (; m > 0 && xs[m - 1] > x; m--) {
+                xs[m] = xs[m - 1];
+            }
+            xs[m] = x;
+        }
+        for (size_t k = 0; k + 1 < n_active; k += 2) {
+            // centers from ceil(left - 0.5) up to, not including, ceil(right - 0.5)
+            int x0 = (xs[k] + 0x7FFF) >> 16;
+            int x1 = ((xs[k + 1] + 0x7FFF) >> 16) - 1;
+            x0 = MAX(x0, 0);
+            x1 = MIN(x1, (int)self->max_width_value);
+            if (x0 <= x1) {
+                span_add(self, &run, y, x0, x1);
+            }
+        }
+
+        size_t keep = 0;
+        for (size_t k = 0; k < n_active; k++) {
+            poly_edge_t *e = active[k];
+            if (y + 1 < e->y1) {
+                e->x += e->dx;
+                e->err += e->derr;
+                if (e->err >= e->den) {
+                    e->err -= e->den;
+                    e->x++;
+                }
+                active[keep++] = e;
+            }
+        }
+        n_active = keep;
+        y++;
+    }
+    span_end(self, &run);
+
+    m_del(int32_t, xs, count);
+    m_del(poly_edge_t *, active, count);
+    m_del(poly_edge_t, edges, count);
+}
+
+
+// Points are (x, y) records, at least 3 of them.
+STATIC mp_obj_t mp_lcd_rm67162_fill_polygon(size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    uint16_t color = mp_obj_get_int(args_in[2]);
+    size_t count;
+    const int16_t *pts = get_records(args_in[1], 2, &count);
+
+    STATS_START(RM67162_STAT_FILL_POLYGON);
+    fill_polygon(self, pts, count, color);
+    STATS_STOP(self, RM67162_STAT_FILL_POLYGON);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_fill_polygon_obj, 3, 3, mp_lcd_rm67162_fill_polygon);
+
+
+STATIC mp_obj_t mp_lcd_rm67162_fill_triangle(size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    int16_t pts[6];
+    for (int i = 0; i < 6; i++) {
+        pts[i] = mp_obj_get_int(args_in[i + 1]);
+    }
+    uint16_t color = mp_obj_get_int(args_in[7]);
+
+    STATS_START(RM67162_STAT_FILL_TRIANGLE);
+    fill_polygon(self, pts, 3, color);
+    STATS_STOP(self, RM67162_STAT_FILL_TRIANGLE);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_fill_triangle_obj, 8, 8, mp_lcd_rm67162_fill_triangle);
+
+// Draws the runs of all eight octants for the octant run x0..x1 on row y.
+STATIC void circle_runs(mp_lcd_rm67162_obj_t *self, int xm, int ym, int x0, int x1, int y, uint16_t color) {
+    if (x0 == 0) {
+        // the runs touching the axes join their mirrored twin
+        fill_area(self, xm - x1, ym - y, xm + x1, ym - y, color);
+        fill_area(self, xm - x1, ym + y, xm + x1, ym + y, color);
+        fill_area(self, xm - y, ym - x1, xm - y, ym + x1, color);
+        fill_area(self, xm + y, ym - x1, xm + y, ym + x1, color);
+    } else {
+        fill_area(self, xm + x0, ym - y, xm + x1, ym - y, color);
+        fill_area(self, xm - x1, ym - y, xm - x0, ym - y, color);
+        fill_area(self, xm + x0, ym + y, xm + x1, ym + y, color);
+        fill_area(self, xm - x1, ym + y, xm - x0, ym + y, color);
+        fill_area(self, xm - y, ym + x0, xm - y, ym + x1, color);
+        fill_area(self, xm - y, ym - x1, xm - y, ym - x0, color);
+        fill_area(self, xm + y, ym + x0, xm + y, ym + x1, color);
+        fill_area(self, xm + y, ym - x1, xm + y, ym - x0, color);
+    }
+}
+
+
+/*
+Similar to: https://en.wikipedia.org/wiki/Midpoint_circle_algorithm
+Consecutive pixels that share a row (or a column in the mirrored octants)
+are sent as one window instead of one window per pixel.
+*/
+STATIC void circle(mp_lcd_rm67162_obj_t *self, int xm, int ym, int r, uint16_t color) {
+    int x = 0;
+    int y = r;
+    int p = 1 - r;
+    int run_start = 0;
+
+    while (x <= y) {
+        int run_y = y;
+
+        if (p < 0) {
+            p += 2 * x + 3;
+        } else {
+            p += 2 * (x - y) + 5;
+            y -= 1;
+        }
+        x += 1;
+
+        if (y != run_y || x > y) {
+            circle_runs(self, xm, ym, run_start, x - 1, run_y, color);
+            run_start = x;
+        }
+    }
+}
+
+
+STATIC mp_obj_t mp_lcd_rm67162_circle(size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    int xm = mp_obj_get_int(args_in[1]);
+    int ym = mp_obj_get_int(args_in[2]);
+    int r = mp_obj_get_int(args_in[3]);
+    uint16_t color = mp_obj_get_int(args_in[4]);
+
+    STATS_START(RM67162_STAT_CIRCLE);
+    circle(self, xm, ym, r, color);
+    STATS_STOP(self, RM67162_STAT_CIRCLE);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_circle_obj, 5, 5, mp_lcd_rm67162_circle);
+
+
+STATIC void fill_circle(mp_lcd_rm67162_obj_t *self, int xm, int ym, int r, uint16_t color) {
+    int x = 0;
+    int y = r;
+    int p = 1 - r;
+
+    if (r < 0) {
+        return;
+    }
+
+    // half width of the circle for every row offset, taken from the same
+    // midpoint walk as circle() so the outline and the fill line up.
+    uint16_t *half = m_new(uint16_t, r + 1);
+    memset(half, 0, (r + 1) * sizeof(uint16_t));
+    while (x <= y) {
+        if (half[y] < x) {
+            half[y] = x;
+        }
+        if (half[x] < y) {
+            half[x] = y;
+        }
+
+        if (p < 0) {
+            p += 2 * x + 3;
+        } else {
+            p += 2 * (x - y) + 5;
+            y -= 1;
+        }
+        x += 1;
+    }
+
+    int dy_start = (ym - r < 0) ? -ym : -r;
+    int dy_end = (ym + r > self->max_height_value) ? self->max_height_value - ym : r;
+    span_run_t run;
+    span_begin(&run, color);
+    for (int dy = dy_start; dy <= dy_end; dy++) {
+        int h = half[ABS(dy)];
+        span_add(self, &run, ym + dy, xm - h, xm + h);
+    }
+    span_end(self, &run);
+
+    m_del(uint16_t, half, r + 1);
+}
+
+
+STATIC mp_obj_t mp_lcd_rm67162_fill_circle(size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    int xm = mp_obj_get_int(args_in[1]);
+    int ym = mp_obj_get_int(args_in[2]);
+    int r = mp_obj_get_int(args_in[3]);
+    uint16_t color = mp_obj_get_int(args_in[4]);
+
+    STATS_START(RM67162_STAT_FILL_CIRCLE);
+    fill_circle(self, xm, ym, r, color);
+    STATS_STOP(self, RM67162_STAT_FILL_CIRCLE);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_fill_circle_obj, 5, 5, mp_lcd_rm67162_fill_circle);
+
+
+
+// Copy a bitmap into the shadow, clipped to the screen. Rows are stride
+// pixels apart in buf, convert turns them into RGB565_SWAPPED, NULL if they
+// already are.
+STATIC void shadow_bitmap(mp_lcd_rm67162_obj_t *self, int x_start, int y_start, int x_end, int y_end,
+                          const uint16_t *buf, int stride, lcd_panel_convert_t convert) {
+    int x0 = MAX(x_start, 0);
+    int y0 = MAX(y_start, 0);
+    int x1 = MIN(x_end - 1, self->max_width_value);
+    int y1 = MIN(y_end - 1, self->max_height_value);
+    if (x0 > x1 || y0 > y1) {
+        return;
+    }
+
+    for (int y = y0; y <= y1; y++) {
+        uint16_t *dst = self->shadow + y * self->width + x0;
+        const uint16_t *src = buf + (y - y_start) * stride + (x0 - x_start);
+        if (convert) {
+            convert((uint8_t *)dst, src, x1 - x0 + 1);
+        } else {
+            memcpy(dst, src, (x1 - x0 + 1) * 2);
+        }
+    }
+    mark_dirty(self, x0, y0, x1, y1);
+}
+
+
+// Returns the kernel turning bitmap data of format into what bitmap() sends,
+// NULL if it goes out as it is. -1 is the format bitmap() expects anyway.
+STATIC lcd_panel_convert_t bitmap_convert(mp_lcd_rm67162_obj_t *self, int *format) {
+    // the shadow holds colors, without it the data goes out as it is
+    int panel_format = self->shadow ? PIXEL_FORMAT_RGB565_SWAPPED : self->pixel_format;
+    if (*format == -1) {
+        *format = panel_format;
+    }
+    if (*format == panel_format) {
+        return NULL;
+    }
+    if (*format != PIXEL_FORMAT_RGB565 && *format != PIXEL_FORMAT_RGB565_SWAPPED) {
+        mp_raise_ValueError(MP_ERROR_TEXT("unsupported format"));
+    }
+    return lcd_panel_convert_get(*format, panel_format);
+}
+
+
+// Draw w x h pixels from src at (x, y), clipped to the screen. Rows are
+// stride pixels of src_bytes each apart in src, which is held by src_obj.
+STATIC void blit(mp_lcd_rm67162_obj_t *self, int x, int y, int w, int h, mp_obj_t src_obj,
+                 const uint8_t *src, int stride, size_t src_bytes, lcd_panel_convert_t convert) {
+    int x0 = MAX(x, 0);
+    int y0 = MAX(y, 0);
+    int x1 = MIN(x + w - 1, self->max_width_value);
+    int y1 = MIN(y + h - 1, self->max_height_value);
+    if (x0 > x1 || y0 > y1) {
+        return;
+    }
+    src += ((size_t)(y0 - y) * stride + (x0 - x)) * src_bytes;
+    w = x1 - x0 + 1;
+    h = y1 - y0 + 1;
+
+    if (self->shadow) {
+        shadow_bitmap(self, x0, y0, x1 + 1, y1 + 1, (const uint16_t *)src, stride, convert);
+        return;
+    }
+
+    x0 += self->x_gap;
+    y0 += self->y_gap;
+
+    if (convert || stride != w) {
+        // rows that are not contiguous are gathered into the frame buffer
+        send_converted(self, x0, y0, w, h, src, stride * src_bytes, convert);
+        return;
+    }
+
+    set_window(self, x0, y0, x0 + w - 1, y0 + h - 1);
+    write_source(self, src_obj);
+    write_color(self, src, w * h * src_bytes);
+}
+
+
+STATIC mp_obj_t mp_lcd_rm67162_bitmap(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum {
+        ARG_self,
+        ARG_x_start,
+        ARG_y_start,
+        ARG_x_end,
+        ARG_y_end,
+        ARG_buf,
+        ARG_format,
+        ARG_stride,
+        ARG_src_x,
+        ARG_src_y
+    };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_self,    MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_x_start, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0}           },
+        { MP_QSTR_y_start, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0}           },
+        { MP_QSTR_x_end,   MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0}           },
+        { MP_QSTR_y_end,   MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0}           },
+        { MP_QSTR_buf,     MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_format,  MP_ARG_INT,                   {.u_int = -1}          },
+        { MP_QSTR_stride,  MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 0}           },
+        { MP_QSTR_src_x,   MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 0}           },
+        { MP_QSTR_src_y,   MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = 0}           },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args[ARG_self].u_obj);
+
+    int x_start = args[ARG_x_start].u_int;
+    int y_start = args[ARG_y_start].u_int;
+    int x_end   = args[ARG_x_end].u_int;
+    int y_end   = args[ARG_y_end].u_int;
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_buf].u_obj, &bufinfo, MP_BUFFER_READ);
+
+    int format = args[ARG_format].u_int;
+    lcd_panel_convert_t convert = bitmap_convert(self, &format);
+
+    // the area is taken from (src_x, src_y) of a source stride pixels wide
+    int w = x_end - x_start;
+    int h = y_end - y_start;
+    int stride = args[ARG_stride].u_int ? args[ARG_stride].u_int : w;
+    int src_x = args[ARG_src_x].u_int;
+    int src_y = args[ARG_src_y].u_int;
+    if (w <= 0 || h <= 0) {
+        return mp_const_none;
+    }
+    if (src_x < 0 || src_y < 0 || src_x + w > stride) {
+        mp_raise_ValueError(MP_ERROR_TEXT("area outside of the source"));
+    }
+    size_t src_bytes = (format == PIXEL_FORMAT_RGB666 || format == PIXEL_FORMAT_RGB888) ? 3 : 2;
+    if (((size_t)(src_y + h - 1) * stride + src_x + w) * src_bytes > bufinfo.len) {
+        mp_raise_ValueError(MP_ERROR_TEXT("buffer too small"));
+    }
+    const uint8_t *src = (const uint8_t *)bufinfo.buf + ((size_t)src_y * stride + src_x) * src_bytes;
+
+    STATS_START(RM67162_STAT_BITMAP);
+    blit(self, x_start, y_start, w, h, args[ARG_buf].u_obj, src, stride, src_bytes, convert);
+    STATS_STOP(self, RM67162_STAT_BITMAP);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mp_lcd_rm67162_bitmap_obj, 6, mp_lcd_rm67162_bitmap);
+
+
+/*----------------------------------------------------------------------------------------------------
+Compressed bitmaps. The image is decoded band by band into one of two transfer buffers while the band
+before it, in the other buffer, is still on the wire in queued mode.
+-----------------------------------------------------------------------------------------------------*/
+
+
+STATIC uint8_t *decode_buffer(mp_lcd_rm67162_obj_t *self) {
+    if (self->decode_buffer == NULL) {
+        self->decode_buffer = gc_alloc(2 * RM67162_DECODE_BUFFER_SIZE, 0);
+        if (self->decode_buffer == NULL) {
+            mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Failed to allocate decode buffer."));
+        }
+    }
+    return self->decode_buffer;
+}
+
+
+// Decode the next row of image to out in the format of the panel, only the
+// cols pixels after the first left ones are kept.
+STATIC void decode_row(mp_lcd_rm67162_obj_t *self, lcd_image_t *image, uint8_t *out, int left, int cols) {
+    lcd_image_read(image, NULL, left);
+    if (self->convert) {
+        uint16_t colors[64];
+        for (int done = 0; done < cols;) {
+            int n = MIN(cols - done, (int)MP_ARRAY_SIZE(colors));
+            lcd_image_read(image, colors, n);
+            self->convert(out + done * self->pixel_bytes, colors, n);
+            done += n;
+        }
+    } else {
+        lcd_image_read(image, (uint16_t *)out, cols);
+    }
+    lcd_image_read(image, NULL, image->width - left - cols);
+}
+
+
+// Draw image at (x, y), clipped to the screen. Rows above the screen are
+// decoded and dropped, those below it are not decoded at all.
+STATIC void draw_compressed(mp_lcd_rm67162_obj_t *self, lcd_image_t *image, int x, int y) {
+    int x0 = MAX(x, 0);
+    int y0 = MAX(y, 0);
+    int x1 = MIN(x + image->width - 1, self->max_width_value);
+    int y1 = MIN(y + image->height - 1, self->max_height_value);
+    if (x0 > x1 || y0 > y1) {
+        return;
+    }
+    int left = x0 - x;
+    int cols = x1 - x0 + 1;
+    lcd_image_read(image, NULL, (size_t)(y0 - y) * image->width);
+
+    if (self->shadow) {
+        for (int row = y0; row <= y1; row++) {
+            lcd_image_read(image, NULL, left);
+            lcd_image_read(image, self->shadow + row * self->width + x0, cols);
+            lcd_image_read(image, NULL, image->width - left - cols);
+        }
+        mark_dirty(self, x0, y0, x1, y1);
+        return;
+    }
+
+    size_t line = cols * self->pixel_bytes;
+    int band = RM67162_DECODE_BUFFER_SIZE / line;
+    if (band == 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("area too wide"));
+    }
+    uint8_t *buffers = decode_buffer(self);
+    int next = 0;
+    for (int row = y0; row <= y1; row += band) {
+        int last = MIN(row + band - 1, y1);
+        // the other buffer may still be on the wire, this one was sent before it
+        uint8_t *buf = buffers + next * RM67162_DECODE_BUFFER_SIZE;
+        for (int i = row; i <= last; i++) {
+            decode_row(self, image, buf + (i - row) * line, left, cols);
+        }
+        wait_bus(self);
+        set_window(self, x0 + self->x_gap, row + self->y_gap, x1 + self->x_gap, last + self->y_gap);
+        write_color(self, buf, line * (last - row + 1));
+        next ^= 1;
+    }
+}
+
+
+STATIC mp_obj_t mp_lcd_rm67162_bitmap_compressed(size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    int x = mp_obj_get_int(args_in[1]);
+    int y = mp_obj_get_int(args_in[2]);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args_in[3], &bufinfo, MP_BUFFER_READ);
+
+    lcd_image_t image;
+    lcd_image_open(&image, bufinfo.buf, bufinfo.len);
+
+    STATS_START(RM67162_STAT_BITMAP_COMPRESSED);
+    draw_compressed(self, &image, x, y);
+    STATS_STOP(self, RM67162_STAT_BITMAP_COMPRESSED);
+
+    mp_obj_t size[2] = {
+        mp_obj_new_int(image.width),
+        mp_obj_new_int(image.height),
+    };
+    return mp_obj_new_tuple(2, size);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_bitmap_compressed_obj, 4, 4, mp_lcd_rm67162_bitmap_compressed);
+
+
+/*----------------------------------------------------------------------------------------------------
+Text. Glyphs are colorized once into the format they are copied to and kept in the glyph cache, a
+line of text is then put together row by row with memcpy and sent as one window.
+-----------------------------------------------------------------------------------------------------*/
+
+
+STATIC lcd_glyph_cache_t *glyph_cache(mp_lcd_rm67162_obj_t *self) {
+    if (self->glyph_cache == NULL) {
+        self->glyph_cache = m_new_obj(lcd_glyph_cache_t);
+        // the shadow holds colors, the text buffer what the panel expects
+        if (self->shadow) {
+            lcd_glyph_cache_init(self->glyph_cache, 2, NULL);
+        } else {
+            lcd_glyph_cache_init(self->glyph_cache, self->pixel_bytes, self->convert);
+        }
+    }
+    return self->glyph_cache;
+}
+
+
+// Make the text buffer hold len bytes, or RM67162_TEXT_BUFFER_SIZE if that is less.
+STATIC void text_buffer_reserve(mp_lcd_rm67162_obj_t *self, size_t len) {
+    len = MIN(len, RM67162_TEXT_BUFFER_SIZE);
+    if (len <= self->text_buffer_size) {
+        return;
+    }
+    // the old one may still be on the wire in queued mode
+    wait_bus(self);
+    if (self->text_buffer) {
+        gc_free(self->text_buffer);
+    }
+    self->text_buffer_size = 0;
+    self->text_buffer = gc_alloc(len, 0);
+    if (self->text_buffer == NULL) {
+        mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Failed to allocate text buffer."));
+    }
+    self->text_buffer_size = len;
+}
+
+
+// Copy the rows y0 to y1 of the text from s to end starting at (x, y) to dst,
+// clipped to the columns x0 to x1. Rows are stride bytes apart in dst, which
+// starts at (x0, y0).
+STATIC void text_rows(lcd_glyph_cache_t *cache, const lcd_font_t *font, const char *s, const char *end,
+                      int x, int y, int x0, int y0, int x1, int y1, uint16_t fg, uint16_t bg,
+                      uint8_t *dst, size_t stride) {
+    size_t pixel_bytes = cache->pixel_bytes;
+    while (s < end && x <= x1) {
+        uint32_t code;
+        s = lcd_font_next_char(s, end, &code);
+        const lcd_glyph_entry_t *glyph = lcd_glyph_cache_get(cache, font, code, fg, bg);
+        if (glyph == NULL) {
+            continue;
+        }
+        int c0 = MAX(x, x0);
+        int c1 = MIN(x + glyph->width - 1, x1);
+        if (c0 <= c1) {
+            size_t len = (c1 - c0 + 1) * pixel_bytes;
+            size_t line = glyph->width * pixel_bytes;
+            const uint8_t *src = glyph->pixels + (y0 - y) * line + (c0 - x) * pixel_bytes;
+            uint8_t *out = dst + (c0 - x0) * pixel_bytes;
+            for (int row = y0; row <= y1; row++) {
+                memcpy(out, src, len);
+                out += stride;
+                src += line;
+            }
+        }
+        x += glyph->width;
+    }
+}
+
+
+// Draw len bytes of UTF-8 text at (x, y), returns its width. Characters the
+// font has no glyph for are skipped.
+STATIC int draw_text(mp_lcd_rm67162_obj_t *self, const lcd_font_t *font, const char *s, size_t len,
+                     int x, int y, uint16_t fg, uint16_t bg) {
+    lcd_glyph_cache_t *cache = glyph_cache(self);
+    const char *end = s + len;
+
+    // this also renders the missing glyphs, the second pass only copies
+    int width = 0;
+    for (const char *p = s; p < end;) {
+        uint32_t code;
+        p = lcd_font_next_char(p, end, &code);
+        const lcd_glyph_entry_t *glyph = lcd_glyph_cache_get(cache, font, code, fg, bg);
+        if (glyph) {
+            width += glyph->width;
+        }
+    }
+
+    int x0 = MAX(x, 0);
+    int y0 = MAX(y, 0);
+    int x1 = MIN(x + width - 1, self->max_width_value);
+    int y1 = MIN(y + font->height - 1, self->max_height_value);
+    if (x0 > x1 || y0 > y1) {
+        return width;
+    }
+
+    if (self->shadow) {
+        text_rows(cache, font, s, end, x, y, x0, y0, x1, y1, fg, bg,
+                  (uint8_t *)(self->shadow + y0 * self->width + x0), self->width * 2);
+        mark_dirty(self, x0, y0, x1, y1);
+        return width;
+    }
+
+    size_t line = (x1 - x0 + 1) * cache->pixel_bytes;
+    text_buffer_reserve(self, line * (y1 - y0 + 1));
+    int band = self->text_buffer_size / line;
+    if (band == 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("area too wide"));
+    }
+    for (int row = y0; row <= y1; row += band) {
+        int last = MIN(row + band - 1, y1);
+        // the previous text may still be read from the buffer in queued mode
+        wait_bus(self);
+        text_rows(cache, font, s, end, x, y, x0, row, x1, last, fg, bg, self->text_buffer, line);
+        set_window(self, x0 + self->x_gap, row + self->y_gap, x1 + self->x_gap, last + self->y_gap);
+        write_color(self, self->text_buffer, line * (last - row + 1));
+    }
+    return width;
+}
+
+
+STATIC mp_obj_t mp_lcd_rm67162_text(size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    lcd_font_t font;
+    lcd_font_get(&font, args_in[1]);
+    size_t len;
+    const char *s = mp_obj_str_get_data(args_in[2], &len);
+    int x = mp_obj_get_int(args_in[3]);
+    int y = mp_obj_get_int(args_in[4]);
+    uint16_t fg = (n_args > 5) ? mp_obj_get_int(args_in[5]) : 0xFFFF;
+    uint16_t bg = (n_args > 6) ? mp_obj_get_int(args_in[6]) : 0x0000;
+
+    STATS_START(RM67162_STAT_TEXT);
+    int width = draw_text(self, &font, s, len, x, y, fg, bg);
+    STATS_STOP(self, RM67162_STAT_TEXT);
+    return mp_obj_new_int(width);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_text_obj, 5, 7, mp_lcd_rm67162_text);
+
+
+// A line of hline()/vline() as a rectangle, following their length rules
+STATIC void span_add_line(mp_lcd_rm67162_obj_t *self, span_run_t *run, int x, int y, uint16_t l, bool vertical, uint16_t color) {
+    if (l == 0) {
+        return;
+    }
+    int len = (l == 1) ? 0 : l;
+    if (vertical) {
+        span_add_rect(self, run, x, y, x, y + len, color);
+    } else {
+        span_add_rect(self, run, x, y, x + len, y, color);
+    }
+}
+
+
+// Draw the operations of a DisplayList moved by (dx, dy). Consecutive
+// pixels, lines and filled rectangles of the same color that continue each
+// other are merged into one window.
+STATIC mp_obj_t mp_lcd_rm67162_replay(size_t n_args, const mp_obj_t *args_in) {
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    if (!mp_obj_is_type(args_in[1], &mp_lcd_display_list_type)) {
+        mp_raise_TypeError(MP_ERROR_TEXT("expected a DisplayList"));
+    }
+    mp_lcd_display_list_obj_t *list = MP_OBJ_TO_PTR(args_in[1]);
+    int dx = (n_args > 2) ? mp_obj_get_int(args_in[2]) : 0;
+    int dy = (n_args > 3) ? mp_obj_get_int(args_in[3]) : 0;
+
+    size_t n_bufs;
+    mp_obj_t *bufs;
+    mp_obj_list_get(list->bufs, &n_bufs, &bufs);
+    STATS_START(RM67162_STAT_REPLAY);
+
+    span_run_t run;
+    span_begin(&run, 0);
+    const uint8_t *code = list->code;
+    const uint8_t *code_end = code + list->len;
+    while (code < code_end) {
+        uint8_t op = *code++;
+        int16_t a[DISPLAY_LIST_MAX_ARGS];
+        size_t n = display_list_args(op);
+        if (n == 0 || code + n * sizeof(int16_t) > code_end) {
+            mp_raise_ValueError(MP_ERROR_TEXT("invalid display list"));
+        }
+        memcpy(a, code, n * sizeof(int16_t));
+        code += n * sizeof(int16_t);
+        int x = a[0] + dx;
+        int y = a[1] + dy;
+
+        switch (op) {
+            case DISPLAY_LIST_OP_PIXEL:
+                span_add_rect(self, &run, x, y, x, y, a[2]);
+                continue;
+            case DISPLAY_LIST_OP_HLINE:
+                span_add_line(self, &run, x, y, a[2], false, a[3]);
+                continue;
+            case DISPLAY_LIST_OP_VLINE:
+                span_add_line(self, &run, x, y, a[2], true, a[3]);
+                continue;
+            case DISPLAY_LIST_OP_FILL_RECT:
+                if ((uint16_t)a[2] > 0 && (uint16_t)a[3] > 0) {
+                    span_add_rect(self, &run, x, y, x + (uint16_t)a[2] - 1, y + (uint16_t)a[3] - 1, a[4]);
+                }
+                continue;
+            case DISPLAY_LIST_OP_RECT:
+                span_add_line(self, &run, x, y, a[2], false, a[4]);
+                span_add_line(self, &run, x, y + (uint16_t)a[3], a[2], false, a[4]);
+                span_add_line(self, &run, x, y, a[3], true, a[4]);
+                span_add_line(self, &run, x + (uint16_t)a[2], y, a[3], true, a[4]);
+                continue;
+        }
+
+        // everything else is drawn on its own, after the pending run
+        span_end(self, &run);
+        switch (op) {
+            case DISPLAY_LIST_OP_FILL:
+                fast_fill(self, a[0]);
+                break;
+            case DISPLAY_LIST_OP_FILL_CIRCLE:
+                fill_circle(self, x, y, a[2], a[3]);
+                break;
+            case DISPLAY_LIST_OP_CIRCLE:
+                circle(self, x, y, a[2], a[3]);
+                break;
+            case DISPLAY_LIST_OP_BITMAP: {
+                int w = a[2];
+                int h = a[3];
+                int format = a[4];
+                if ((size_t)a[5] >= n_bufs) {
+                    mp_raise_ValueError(MP_ERROR_TEXT("invalid display list"));
+                }
+                lcd_panel_convert_t convert = bitmap_convert(self, &format);
+                size_t src_bytes = lcd_panel_format_bytes(format);
+                mp_buffer_info_t bufinfo;
+                mp_get_buffer_raise(bufs[a[5]], &bufinfo, MP_BUFFER_READ);
+                if ((size_t)w * h * src_bytes > bufinfo.len) {
+                    mp_raise_ValueError(MP_ERROR_TEXT("buffer too small"));
+                }
+                blit(self, x, y, w, h, bufs[a[5]], bufinfo.buf, w, src_bytes, convert);
+                break;
+            }
+        }
+    }
+    span_end(self, &run);
+
+    STATS_STOP(self, RM67162_STAT_REPLAY);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_replay_obj, 2, 4, mp_lcd_rm67162_replay);
+
+
+// Wait for the rising edge of the TE signal, which the panel raises when it
+// reaches the scanline set with tearing_effect(). The edge comes in through
+// a gpio interrupt, so the wait sleeps rather than spinning on the pin.
+STATIC void wait_te(mp_lcd_rm67162_obj_t *self) {
+#if USE_ESP_LCD
+    if (self->te_edge == NULL || !self->te_enabled) {
+        return;
+    }
+    hal_lcd_te_wait(self->te_edge, RM67162_TE_TIMEOUT_US);
+#endif
+}
+
+
+// Sleep until the next frame is due. A frame that is more than one period
+// late restarts the schedule instead of rushing to catch up.
+STATIC void pace_frame(mp_lcd_rm67162_obj_t *self) {
+    if (self->frame_us == 0) {
+        return;
+    }
+
+    uint32_t now = mp_hal_ticks_us();
+    int32_t ahead = (int32_t)(self->frame_deadline - now);
+    if (ahead > (int32_t)self->frame_us || -ahead > (int32_t)self->frame_us) {
+        self->frame_deadline = now + self->frame_us;
+        if (ahead < 0) {
+            self->stats.late_frames++;
+        }
+        return;
+    }
+    if (ahead > 0) {
+        mp_hal_delay_us(ahead);
+        self->stats.pace_wait_us += ahead;
+    }
+    self->frame_deadline += self->frame_us;
+}
+
+
+STATIC mp_obj_t mp_lcd_rm67162_tearing_effect(size_t n_args, const mp_obj_t *args_in)
+{
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(args_in[0]);
+    bool enable = mp_obj_is_true(args_in[1]);
+    uint16_t scanline = 0;
+    if (n_args == 3) {
+        scanline = mp_obj_get_int(args_in[2]);
+    }
+
+    if (enable) {
+        write_spi(self, LCD_CMD_STE, (uint8_t[]) {
+            scanline >> 8, scanline & 0xFF
+        }, 2);
+        // V-blank only, no H-blank pulses
+        write_spi(self, LCD_CMD_TEON, (uint8_t[]) { 0x00 }, 1);
+    } else {
+        write_spi(self, LCD_CMD_TEOFF, NULL, 0);
+    }
+    self->te_enabled = enable;
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_tearing_effect_obj, 2, 3, mp_lcd_rm67162_tearing_effect);
+
+
+STATIC mp_obj_t mp_lcd_rm67162_target_fps(mp_obj_t self_in, mp_obj_t fps_in)
+{
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_int_t fps = mp_obj_get_int(fps_in);
+
+    if (fps < 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("fps must be positive"));
+    }
+    self->frame_us = fps ? 1000000 / fps : 0;
+    self->frame_deadline = mp_hal_ticks_us();
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mp_lcd_rm67162_target_fps_obj, mp_lcd_rm67162_target_fps);
+
+
+// Finish a frame: wait until it is due and for the panel to reach the TE
+// scanline, then send the changed parts of the shadow.
+STATIC mp_obj_t mp_lcd_rm67162_present(mp_obj_t self_in)
+{
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    STATS_START(RM67162_STAT_PRESENT);
+
+    pace_frame(self);
+    // the previous frame has to be off the bus before the edge, or it is
+    // still being sent while the refresh passes the start of this one
+    wait_bus(self);
+    uint32_t te_start = mp_hal_ticks_us();
+    wait_te(self);
+    self->stats.te_wait_us += mp_hal_ticks_us() - te_start;
+    if (self->shadow) {
+        show(self);
+    }
+    self->stats.frames++;
+    STATS_STOP(self, RM67162_STAT_PRESENT);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_rm67162_present_obj, mp_lcd_rm67162_present);
+
+
+STATIC mp_obj_t mp_lcd_rm67162_show(mp_obj_t self_in)
+{
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    if (self->shadow) {
+        STATS_START(RM67162_STAT_SHOW);
+        show(self);
+        STATS_STOP(self, RM67162_STAT_SHOW);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_rm67162_show_obj, mp_lcd_rm67162_show);
+
+
+STATIC mp_obj_t mp_lcd_rm67162_wait(mp_obj_t self_in)
+{
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    wait_bus(self);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_rm67162_wait_obj, mp_lcd_rm67162_wait);
+
+
+STATIC mp_obj_t mp_lcd_rm67162_busy(mp_obj_t self_in)
+{
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    return mp_obj_new_bool(bus_busy(self));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_rm67162_busy_obj, mp_lcd_rm67162_busy);
+
+
+// Scheduled by the bus once the transfers are done.
+STATIC mp_obj_t transfer_done(mp_obj_t flag)
+{
+    mp_obj_t dest[2];
+    mp_load_method(flag, MP_QSTR_set, dest);
+    return mp_call_method_n_kw(0, 0, dest);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(transfer_done_obj, transfer_done);
+
+
+STATIC mp_obj_t new_thread_safe_flag(mp_lcd_rm67162_obj_t *self)
+{
+    if (self->flag_type == MP_OBJ_NULL) {
+        mp_obj_t asyncio;
+        nlr_buf_t nlr;
+
+        if (nlr_push(&nlr) == 0) {
+            asyncio = mp_import_name(MP_QSTR_asyncio, mp_const_none, MP_OBJ_NEW_SMALL_INT(0));
+            nlr_pop();
+        } else {
+            // firmware older than v1.21
+            asyncio = mp_import_name(MP_QSTR_uasyncio, mp_const_none, MP_OBJ_NEW_SMALL_INT(0));
+        }
+        self->flag_type = mp_load_attr(asyncio, MP_QSTR_ThreadSafeFlag);
+    }
+    return mp_call_function_0(self->flag_type);
+}
+
+
+// Returns ThreadSafeFlag.wait() of a flag the bus sets, from the transfer
+// complete callback, once everything sent so far is done. The coroutine
+// awaiting it sleeps in the event loop meanwhile, so other tasks keep running.
+// Every call gets a flag of its own, so concurrent calls can not wake or
+// clear each other.
+STATIC mp_obj_t transfer_done_awaitable(mp_lcd_rm67162_obj_t *self)
+{
+    mp_obj_t dest[2];
+    mp_obj_t flag = new_thread_safe_flag(self);
+
+    if (self->lcd_panel_p && self->lcd_panel_p->notify && bus_busy(self)) {
+        self->lcd_panel_p->notify(self->bus_obj, MP_OBJ_FROM_PTR(&transfer_done_obj), flag);
+    } else {
+        transfer_done(flag);
+    }
+
+    mp_load_method(flag, MP_QSTR_wait, dest);
+    return mp_call_method_n_kw(0, 0, dest);
+}
+
+
+// await tft.flush_async(): show() the shadow framebuffer, then wait for the
+// bus without blocking the event loop.
+STATIC mp_obj_t mp_lcd_rm67162_flush_async(mp_obj_t self_in)
+{
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    mp_lcd_rm67162_show(self_in);
+    return transfer_done_awaitable(self);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_rm67162_flush_async_obj, mp_lcd_rm67162_flush_async);
+
+
+// await tft.bitmap_async(...): bitmap(), then wait until it was sent.
+STATIC mp_obj_t mp_lcd_rm67162_bitmap_async(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(pos_args[0]);
+
+    mp_lcd_rm67162_bitmap(n_args, pos_args, kw_args);
+    return transfer_done_awaitable(self);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mp_lcd_rm67162_bitmap_async_obj, 6, mp_lcd_rm67162_bitmap_async);
+
+
+
+// Bus traffic of the driver, frame pacing and the latency of every primitive
+// that was called at least once.
+STATIC mp_obj_t mp_lcd_rm67162_stats(mp_obj_t self_in)
+{
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    rm67162_stats_t *st = &self->stats;
+
+    mp_obj_t latency = mp_obj_new_dict(0);
+    for (int i = 0; i < RM67162_STATS; i++) {
+        if (st->latency[i].count) {
+            mp_obj_dict_store(latency, MP_OBJ_NEW_QSTR(rm67162_stat_names[i]), lcd_stats_hist_dict(&st->latency[i]));
+        }
+    }
+
+    mp_obj_t stats = mp_obj_new_dict(13);
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_transactions),
+        mp_obj_new_int_from_uint(st->param_transactions + st->color_transactions));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_bytes),
+        mp_obj_new_int_from_ull(st->param_bytes + st->color_bytes));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_tx_param), mp_obj_new_int_from_uint(st->param_transactions));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_tx_color), mp_obj_new_int_from_uint(st->color_transactions));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_param_bytes), mp_obj_new_int_from_ull(st->param_bytes));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_color_bytes), mp_obj_new_int_from_ull(st->color_bytes));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_frames), mp_obj_new_int_from_uint(st->frames));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_late_frames), mp_obj_new_int_from_uint(st->late_frames));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_pace_wait_us), mp_obj_new_int_from_ull(st->pace_wait_us));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_te_wait_us), mp_obj_new_int_from_ull(st->te_wait_us));
+    lcd_glyph_cache_t *cache = self->glyph_cache;
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_glyph_hits), mp_obj_new_int_from_uint(cache ? cache->hits : 0));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_glyph_misses), mp_obj_new_int_from_uint(cache ? cache->misses : 0));
+    mp_obj_dict_store(stats, MP_OBJ_NEW_QSTR(MP_QSTR_latency), latency);
+    return stats;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_rm67162_stats_obj, mp_lcd_rm67162_stats);
+
+
+STATIC mp_obj_t mp_lcd_rm67162_reset_stats(mp_obj_t self_in)
+{
+    mp_lcd_rm67162_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    memset(&self->stats, 0, sizeof(self->stats));
+    if (self->glyph_cache) {
+        self->glyph_cache->hits = 0;
+        self->glyph_cache->misses = 0;
+    }
     return mp_const_none;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_lcd_rm67162_bitmap_obj, 6, 6, mp_lcd_rm67162_bitmap);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_lcd_rm67162_reset_stats_obj, mp_lcd_rm67162_reset_stats);
 
 
 /*---------------------------------------------------------------------------------------------------
@@ -905,11 +2679,31 @@ STATIC const mp_rom_map_elem_t mp_lcd_rm67162_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_vline),         MP_ROM_PTR(&mp_lcd_rm67162_vline_obj)         },
     { MP_ROM_QSTR(MP_QSTR_fill),          MP_ROM_PTR(&mp_lcd_rm67162_fill_obj)          },
     { MP_ROM_QSTR(MP_QSTR_fill_rect),     MP_ROM_PTR(&mp_lcd_rm67162_fill_rect_obj)     },
+    { MP_ROM_QSTR(MP_QSTR_pixels),        MP_ROM_PTR(&mp_lcd_rm67162_pixels_obj)        },
+    { MP_ROM_QSTR(MP_QSTR_hlines),        MP_ROM_PTR(&mp_lcd_rm67162_hlines_obj)        },
+    { MP_ROM_QSTR(MP_QSTR_fill_rects),    MP_ROM_PTR(&mp_lcd_rm67162_fill_rects_obj)    },
+    { MP_ROM_QSTR(MP_QSTR_replay),        MP_ROM_PTR(&mp_lcd_rm67162_replay_obj)        },
+    { MP_ROM_QSTR(MP_QSTR_stats),         MP_ROM_PTR(&mp_lcd_rm67162_stats_obj)         },
+    { MP_ROM_QSTR(MP_QSTR_reset_stats),   MP_ROM_PTR(&mp_lcd_rm67162_reset_stats_obj)   },
     { MP_ROM_QSTR(MP_QSTR_fill_circle),   MP_ROM_PTR(&mp_lcd_rm67162_fill_circle_obj)   },
     { MP_ROM_QSTR(MP_QSTR_rect),          MP_ROM_PTR(&mp_lcd_rm67162_rect_obj)          },
     { MP_ROM_QSTR(MP_QSTR_circle),        MP_ROM_PTR(&mp_lcd_rm67162_circle_obj)        },
     { MP_ROM_QSTR(MP_QSTR_colorRGB),      MP_ROM_PTR(&mp_lcd_rm67162_colorRGB_obj)      },
+    { MP_ROM_QSTR(MP_QSTR_line),          MP_ROM_PTR(&mp_lcd_rm67162_line_obj)          },
+    { MP_ROM_QSTR(MP_QSTR_polyline),      MP_ROM_PTR(&mp_lcd_rm67162_polyline_obj)      },
+    { MP_ROM_QSTR(MP_QSTR_fill_polygon),  MP_ROM_PTR(&mp_lcd_rm67162_fill_polygon_obj)  },
+    { MP_ROM_QSTR(MP_QSTR_fill_triangle), MP_ROM_PTR(&mp_lcd_rm67162_fill_triangle_obj) },
     { MP_ROM_QSTR(MP_QSTR_bitmap),        MP_ROM_PTR(&mp_lcd_rm67162_bitmap_obj)        },
+    { MP_ROM_QSTR(MP_QSTR_bitmap_compressed), MP_ROM_PTR(&mp_lcd_rm67162_bitmap_compressed_obj) },
+    { MP_ROM_QSTR(MP_QSTR_text),          MP_ROM_PTR(&mp_lcd_rm67162_text_obj)          },
+    { MP_ROM_QSTR(MP_QSTR_show),          MP_ROM_PTR(&mp_lcd_rm67162_show_obj)          },
+    { MP_ROM_QSTR(MP_QSTR_present),       MP_ROM_PTR(&mp_lcd_rm67162_present_obj)       },
+    { MP_ROM_QSTR(MP_QSTR_tearing_effect), MP_ROM_PTR(&mp_lcd_rm67162_tearing_effect_obj) },
+    { MP_ROM_QSTR(MP_QSTR_target_fps),    MP_ROM_PTR(&mp_lcd_rm67162_target_fps_obj)    },
+    { MP_ROM_QSTR(MP_QSTR_wait),          MP_ROM_PTR(&mp_lcd_rm67162_wait_obj)          },
+    { MP_ROM_QSTR(MP_QSTR_busy),          MP_ROM_PTR(&mp_lcd_rm67162_busy_obj)          },
+    { MP_ROM_QSTR(MP_QSTR_flush_async),   MP_ROM_PTR(&mp_lcd_rm67162_flush_async_obj)   },
+    { MP_ROM_QSTR(MP_QSTR_bitmap_async),  MP_ROM_PTR(&mp_lcd_rm67162_bitmap_async_obj)  },
     { MP_ROM_QSTR(MP_QSTR_mirror),        MP_ROM_PTR(&mp_lcd_rm67162_mirror_obj)        },
     { MP_ROM_QSTR(MP_QSTR_swap_xy),       MP_ROM_PTR(&mp_lcd_rm67162_swap_xy_obj)       },
     { MP_ROM_QSTR(MP_QSTR_set_gap),       MP_ROM_PTR(&mp_lcd_rm67162_set_gap_obj)       },
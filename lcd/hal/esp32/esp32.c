@@ -1,22 +1,334 @@
 #include "esp32.h"
 
 #include "qspi_panel.h"
+#include "lcd_trace.h"
 
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_vendor.h"
 #include "esp_lcd_panel_ops.h"
 #include "esp_lcd_panel_rgb.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_task.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "freertos/semphr.h"
+#include "hal/gpio_ll.h"
+#if __has_include("esp_memory_utils.h")
+#include "esp_memory_utils.h"
+#else
+#include "soc/soc_memory_layout.h"
+#endif
 
 #include "machine_hw_spi.c"
+#include "mphalport.h"
 #include "py/runtime.h"
 
+#include <sys/param.h>
+
 #define DEBUG_printf(...) // mp_printf(&mp_plat_print, __VA_ARGS__);
 
+// cs is driven from the transaction callbacks, the user field of every
+// transaction carries the bus object and what to do with it. gc blocks are
+// at least 8 byte aligned, which leaves the low bits for the flags.
+#define QSPI_TRANS_CS_ASSERT  (1 << 0)
+#define QSPI_TRANS_CS_RELEASE (1 << 1)
+#define QSPI_TRANS_QUEUED     (1 << 2) // counted in trans_done when finished
+#define QSPI_TRANS_FLAGS      (7)
+#define QSPI_TRANS_USER(obj, flags) ((void *)((uintptr_t)(obj) | (flags)))
+#define QSPI_TRANS_OBJ(user) ((mp_lcd_qspi_panel_obj_t *)((uintptr_t)(user) & ~QSPI_TRANS_FLAGS))
+
+// the flush worker sits above the micropython task, so it picks up new
+// transactions right away when both end up on the same core.
+#define QSPI_WORKER_PRIORITY   (ESP_TASK_PRIO_MIN + 2)
+#define QSPI_WORKER_STACK_SIZE (3072)
+
+_Static_assert(QSPI_PANEL_WORKER_DEPTH >= QSPI_PANEL_QUEUE_DEPTH, "trans[] is shared by both modes");
+_Static_assert((QSPI_PANEL_WORKER_DEPTH & (QSPI_PANEL_WORKER_DEPTH - 1)) == 0, "the worker queue needs a power of two");
+
+
+// The dma pool is a single block of internal, dma capable ram for
+// alloc_buffer(), reserved by its first call and never given back. It is
+// handed out in fixed size blocks, so allocations can not fragment the heap
+// no matter how long the device runs.
+#define HAL_LCD_DMA_BLOCK_SIZE (4096)
+#define HAL_LCD_DMA_POOL_MAX_BLOCKS (32) // the pool map has 32 bits
+
+_Static_assert(QSPI_PANEL_DMA_POOL_MAX_SIZE == HAL_LCD_DMA_POOL_MAX_BLOCKS * HAL_LCD_DMA_BLOCK_SIZE, "dma pool limit");
+
+STATIC uint8_t *dma_pool;
+STATIC int dma_pool_size;                                      // blocks
+STATIC uint32_t dma_pool_used;                                 // one bit per block
+STATIC uint8_t dma_pool_blocks[HAL_LCD_DMA_POOL_MAX_BLOCKS];   // blocks of the allocation starting here
+STATIC mp_lcd_dma_buffer_obj_t *dma_pool_owner[HAL_LCD_DMA_POOL_MAX_BLOCKS]; // DMABuffer of every block in use
+
+STATIC void hal_lcd_qspi_panel_wait_seq(mp_lcd_qspi_panel_obj_t *qspi_panel_obj, uint32_t seq);
+
+
+// Reserves pool_size bytes for the pool on the first call, later calls share
+// that pool. owner is the DMABuffer the blocks are handed to.
+void *hal_lcd_dma_alloc(mp_obj_base_t *owner, size_t size, size_t pool_size)
+{
+    if (dma_pool == NULL) {
+        int blocks = (pool_size + HAL_LCD_DMA_BLOCK_SIZE - 1) / HAL_LCD_DMA_BLOCK_SIZE;
+        dma_pool = heap_caps_malloc(blocks * HAL_LCD_DMA_BLOCK_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (dma_pool == NULL) {
+            return NULL;
+        }
+        dma_pool_size = blocks;
+    }
+
+    int n = (size + HAL_LCD_DMA_BLOCK_SIZE - 1) / HAL_LCD_DMA_BLOCK_SIZE;
+    if (n == 0 || n > dma_pool_size) {
+        return NULL;
+    }
+
+    // first fit
+    uint32_t mask = (n == 32) ? UINT32_MAX : ((1u << n) - 1);
+    for (int i = 0; i + n <= dma_pool_size; i++) {
+        if ((dma_pool_used & (mask << i)) == 0) {
+            dma_pool_used |= mask << i;
+            dma_pool_blocks[i] = n;
+            for (int j = i; j < i + n; j++) {
+                dma_pool_owner[j] = (mp_lcd_dma_buffer_obj_t *)owner;
+            }
+            return dma_pool + i * HAL_LCD_DMA_BLOCK_SIZE;
+        }
+    }
+    return NULL;
+}
+
+
+// The DMABuffer ptr points into, NULL if it is not in the pool.
+STATIC mp_lcd_dma_buffer_obj_t *hal_lcd_dma_owner(const void *ptr)
+{
+    if (dma_pool == NULL || (const uint8_t *)ptr < dma_pool ||
+        (const uint8_t *)ptr >= dma_pool + dma_pool_size * HAL_LCD_DMA_BLOCK_SIZE) {
+        return NULL;
+    }
+    return dma_pool_owner[((const uint8_t *)ptr - dma_pool) / HAL_LCD_DMA_BLOCK_SIZE];
+}
+
+
+// Give an allocation back once the transactions reading it are done.
+void hal_lcd_dma_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    // only the start of an allocation in the pool
+    if (hal_lcd_dma_owner(ptr) == NULL || ((uint8_t *)ptr - dma_pool) % HAL_LCD_DMA_BLOCK_SIZE != 0 ||
+        dma_pool_blocks[((uint8_t *)ptr - dma_pool) / HAL_LCD_DMA_BLOCK_SIZE] == 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("not a DMA pool allocation"));
+    }
+    int i = ((uint8_t *)ptr - dma_pool) / HAL_LCD_DMA_BLOCK_SIZE;
+
+    mp_lcd_dma_buffer_obj_t *owner = dma_pool_owner[i];
+    if (owner->panel != NULL && owner->seq != 0) {
+        hal_lcd_qspi_panel_wait_seq((mp_lcd_qspi_panel_obj_t *)owner->panel, owner->seq);
+    }
+
+    int n = dma_pool_blocks[i];
+    uint32_t mask = (n == 32) ? UINT32_MAX : ((1u << n) - 1);
+    dma_pool_used &= ~(mask << i);
+    dma_pool_blocks[i] = 0;
+    for (int j = i; j < i + n; j++) {
+        dma_pool_owner[j] = NULL;
+    }
+}
+
+
+// Forget panel in the DMABuffers of the pool, once it is gone their
+// finalisers have no transactions left to wait for.
+STATIC void hal_lcd_dma_release_panel(mp_obj_base_t *panel)
+{
+    for (int i = 0; i < HAL_LCD_DMA_POOL_MAX_BLOCKS; i++) {
+        mp_lcd_dma_buffer_obj_t *owner = dma_pool_owner[i];
+        if (owner != NULL && owner->panel == panel) {
+            owner->panel = NULL;
+            owner->seq = 0;
+        }
+    }
+}
+
+
+// internal ram the dma can read without help of the spi driver
+bool hal_lcd_dma_capable(const void *ptr)
+{
+    return esp_ptr_dma_capable(ptr) && ((uintptr_t)ptr & 3) == 0;
+}
+
+
+// Transactions finished so far, in the numbering of trans_seq.
+static inline uint32_t hal_lcd_qspi_panel_completed(mp_lcd_qspi_panel_obj_t *qspi_panel_obj)
+{
+    if (qspi_panel_obj->worker) {
+        return atomic_load(&qspi_panel_obj->worker_queue.tail);
+    }
+    return atomic_load(&qspi_panel_obj->trans_done);
+}
+
+
+// Schedule the callbacks armed by hal_lcd_qspi_panel_notify() whose
+// transaction is done. Runs in the spi interrupt or on the worker's core, so
+// it only touches the atomics and the scheduler, and fires each at most once.
+// A slot is only rearmed once its seq went back to 0, so the callback read
+// before the exchange is still the one that belongs to seq.
+STATIC void IRAM_ATTR hal_lcd_qspi_panel_notify_check(mp_lcd_qspi_panel_obj_t *qspi_panel_obj)
+{
+    uint32_t completed = hal_lcd_qspi_panel_completed(qspi_panel_obj);
+    for (int i = 0; i < QSPI_PANEL_NOTIFY_DEPTH; i++) {
+        uint_fast32_t seq = atomic_load(&qspi_panel_obj->notify_seq[i]);
+        if (seq == 0 || (int32_t)(completed - seq) < 0) {
+            continue;
+        }
+        mp_obj_t callback = qspi_panel_obj->notify_cb[i];
+        mp_obj_t arg = qspi_panel_obj->notify_arg[i];
+        if (atomic_compare_exchange_strong(&qspi_panel_obj->notify_seq[i], &seq, 0)) {
+            mp_sched_schedule(callback, arg);
+        }
+    }
+}
+
+
+STATIC void IRAM_ATTR hal_lcd_qspi_panel_pre_cb(spi_transaction_t *t)
+{
+    uintptr_t user = (uintptr_t)t->user;
+    if (user & QSPI_TRANS_CS_ASSERT) {
+        gpio_ll_set_level(&GPIO, QSPI_TRANS_OBJ(user)->cs_pin, 0);
+    }
+}
+
+
+STATIC void IRAM_ATTR hal_lcd_qspi_panel_post_cb(spi_transaction_t *t)
+{
+    uintptr_t user = (uintptr_t)t->user;
+    if (user & QSPI_TRANS_CS_RELEASE) {
+        gpio_ll_set_level(&GPIO, QSPI_TRANS_OBJ(user)->cs_pin, 1);
+    }
+    if (user & QSPI_TRANS_QUEUED) {
+        mp_lcd_qspi_panel_obj_t *qspi_panel_obj = QSPI_TRANS_OBJ(user);
+        qspi_panel_obj->trans_end_us[(spi_transaction_ext_t *)t - qspi_panel_obj->trans] = esp_timer_get_time();
+        atomic_fetch_add(&qspi_panel_obj->trans_done, 1);
+        hal_lcd_qspi_panel_notify_check(qspi_panel_obj);
+    }
+}
+
+
+// dma descriptors the spi driver sets up per direction, each covers up to 4092 bytes
+#define HAL_LCD_DMA_DESC_SIZE  (12)
+#define HAL_LCD_DMA_DESC_BYTES (4092)
+
+// Work out how pixel data is split into transactions, unless the user did.
+// Chunks hold whole lines and are as large as a transaction can be, but the
+// dma descriptors for them must not take more than 1/16 of the largest free
+// block of dma memory.
+STATIC void hal_lcd_qspi_panel_limits(mp_lcd_qspi_panel_obj_t *qspi_panel_obj)
+{
+    uint32_t line = qspi_panel_obj->width * (qspi_panel_obj->bpp == 16 ? 2 : 3);
+    uint32_t frame = line * qspi_panel_obj->height;
+    uint32_t chunk = qspi_panel_obj->chunk_size;
+    uint32_t max_transfer_sz = qspi_panel_obj->max_transfer_sz;
+
+    if (chunk != 0 && (chunk > QSPI_PANEL_MAX_CHUNK_SIZE || chunk % 4 != 0)) {
+        mp_raise_ValueError(MP_ERROR_TEXT("chunk_size must be a multiple of 4 up to 32768"));
+    }
+    if (chunk != 0 && max_transfer_sz != 0 && chunk > max_transfer_sz) {
+        mp_raise_ValueError(MP_ERROR_TEXT("chunk_size larger than max_transfer_sz"));
+    }
+
+    if (chunk == 0) {
+        chunk = MIN(frame, QSPI_PANEL_MAX_CHUNK_SIZE);
+        if (max_transfer_sz != 0) {
+            chunk = MIN(chunk, max_transfer_sz);
+        }
+
+        size_t dma_free = heap_caps_get_largest_free_block(MALLOC_CAP_DMA);
+        while (chunk > line &&
+               2 * ((chunk + HAL_LCD_DMA_DESC_BYTES - 1) / HAL_LCD_DMA_DESC_BYTES) * HAL_LCD_DMA_DESC_SIZE > dma_free / 16) {
+            chunk /= 2;
+        }
+
+        if (chunk >= line) {
+            chunk -= chunk % line;
+        }
+        chunk &= ~3;
+        if (chunk == 0) {
+            chunk = 4;
+        }
+    }
+    if (max_transfer_sz == 0) {
+        max_transfer_sz = chunk;
+    }
+
+    qspi_panel_obj->chunk_size = chunk;
+    qspi_panel_obj->max_transfer_sz = max_transfer_sz;
+}
+
+
+// Runs on the other core and sends the transactions queued by the micropython
+// task one after the other. Only the spi driver is called from here, the gc,
+// the tracer and the stats stay on the micropython core.
+STATIC void hal_lcd_qspi_panel_worker(void *arg)
+{
+    mp_lcd_qspi_panel_obj_t *qspi_panel_obj = (mp_lcd_qspi_panel_obj_t *)arg;
+
+    while (!atomic_load(&qspi_panel_obj->worker_stop)) {
+        int i = lcd_spsc_front(&qspi_panel_obj->worker_queue);
+        if (i < 0) {
+            // every push notifies, so nothing queued after the check is missed
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        spi_device_polling_transmit(qspi_panel_obj->io_handle, (spi_transaction_t *)&qspi_panel_obj->trans[i]);
+        qspi_panel_obj->trans_end_us[i] = esp_timer_get_time();
+        lcd_spsc_pop(&qspi_panel_obj->worker_queue);
+        xSemaphoreGive(qspi_panel_obj->worker_popped);
+        hal_lcd_qspi_panel_notify_check(qspi_panel_obj);
+    }
+    atomic_store(&qspi_panel_obj->worker_done, true);
+    vTaskDelete(NULL);
+}
+
+
+STATIC void hal_lcd_qspi_panel_worker_start(mp_lcd_qspi_panel_obj_t *qspi_panel_obj)
+{
+#if CONFIG_FREERTOS_UNICORE
+    BaseType_t core = 0;
+#else
+    BaseType_t core = !xPortGetCoreID();
+#endif
+    lcd_spsc_init(&qspi_panel_obj->worker_queue, QSPI_PANEL_WORKER_DEPTH);
+    atomic_init(&qspi_panel_obj->worker_stop, false);
+    atomic_init(&qspi_panel_obj->worker_done, false);
+    qspi_panel_obj->worker_popped = xSemaphoreCreateBinary();
+    if (qspi_panel_obj->worker_popped == NULL) {
+        mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Failed to start the flush worker."));
+    }
+    if (xTaskCreatePinnedToCore(hal_lcd_qspi_panel_worker, "lcd_worker", QSPI_WORKER_STACK_SIZE,
+                                qspi_panel_obj, QSPI_WORKER_PRIORITY,
+                                &qspi_panel_obj->worker_task, core) != pdPASS) {
+        qspi_panel_obj->worker_task = NULL;
+        mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Failed to start the flush worker."));
+    }
+}
+
+
 // qspi
 void hal_lcd_qspi_panel_construct(mp_obj_base_t *self)
 {
     mp_lcd_qspi_panel_obj_t *qspi_panel_obj = (mp_lcd_qspi_panel_obj_t *)self;
     machine_hw_spi_obj_t *spi_obj = ((machine_hw_spi_obj_t *)qspi_panel_obj->spi_obj);
+
+    // the finaliser runs deinit even when one of the steps below raises
+    qspi_panel_obj->io_handle = NULL;
+    qspi_panel_obj->worker_task = NULL;
+    qspi_panel_obj->worker_popped = NULL;
+    for (int i = 0; i < QSPI_PANEL_BOUNCE_BUFFERS; i++) {
+        qspi_panel_obj->bounce[i] = NULL;
+    }
+
     machine_hw_spi_obj_t old_spi_obj = *spi_obj;
     if (spi_obj->state == MACHINE_HW_SPI_STATE_INIT) {
         spi_obj->state = MACHINE_HW_SPI_STATE_DEINIT;
@@ -26,14 +338,15 @@ void hal_lcd_qspi_panel_construct(mp_obj_base_t *self)
     mp_hal_pin_output(qspi_panel_obj->cs_pin);
     mp_hal_pin_od_high(qspi_panel_obj->cs_pin);
 
+    hal_lcd_qspi_panel_limits(qspi_panel_obj);
+
     spi_bus_config_t buscfg = {
         .data0_io_num = qspi_panel_obj->databus_pins[0],
         .data1_io_num = qspi_panel_obj->databus_pins[1],
         .sclk_io_num = spi_obj->sck,
         .data2_io_num = qspi_panel_obj->databus_pins[2],
         .data3_io_num = qspi_panel_obj->databus_pins[3],
-        //.max_transfer_sz = qspi_panel_obj->width * qspi_panel_obj->height * sizeof(uint16_t),
-        .max_transfer_sz = (0x4000 * 16) + 8,
+        .max_transfer_sz = qspi_panel_obj->max_transfer_sz,
         .flags = SPICOMMON_BUSFLAG_MASTER | SPICOMMON_BUSFLAG_GPIO_PINS,
     };
     esp_err_t ret = spi_bus_initialize(spi_obj->host, &buscfg, SPI_DMA_CH_AUTO);
@@ -49,13 +362,283 @@ void hal_lcd_qspi_panel_construct(mp_obj_base_t *self)
         .clock_speed_hz = qspi_panel_obj->pclk,
         .spics_io_num = -1,
         .flags = SPI_DEVICE_HALFDUPLEX,
-        .queue_size = 10,
+        .queue_size = QSPI_PANEL_QUEUE_DEPTH,
+        .pre_cb = hal_lcd_qspi_panel_pre_cb,
+        .post_cb = hal_lcd_qspi_panel_post_cb,
     };
 
     ret = spi_bus_add_device(spi_obj->host, &devcfg, &qspi_panel_obj->io_handle);
     if (ret != 0) {
+        qspi_panel_obj->io_handle = NULL;
+        spi_bus_free(spi_obj->host);
+        spi_obj->state = MACHINE_HW_SPI_STATE_DEINIT;
         mp_raise_msg_varg(&mp_type_OSError, "%d(spi_bus_add_device)", ret);
     }
+
+    qspi_panel_obj->trans_head = 0;
+    qspi_panel_obj->trans_inflight = 0;
+    qspi_panel_obj->trans_seq = 0;
+    atomic_init(&qspi_panel_obj->trans_done, 0);
+    qspi_panel_obj->trace_seq = 0;
+    qspi_panel_obj->trace_slot = 0;
+    qspi_panel_obj->trace_end_us = 0;
+    for (int i = 0; i < QSPI_PANEL_NOTIFY_DEPTH; i++) {
+        atomic_init(&qspi_panel_obj->notify_seq[i], 0);
+        qspi_panel_obj->notify_cb[i] = mp_const_none;
+        qspi_panel_obj->notify_arg[i] = mp_const_none;
+    }
+
+    for (int i = 0; i < QSPI_PANEL_WORKER_DEPTH; i++) {
+        qspi_panel_obj->trans_owner[i] = MP_OBJ_NULL;
+    }
+    qspi_panel_obj->tx_source = MP_OBJ_NULL;
+
+    for (int i = 0; i < QSPI_PANEL_BOUNCE_BUFFERS; i++) {
+        qspi_panel_obj->bounce[i] = heap_caps_malloc(QSPI_PANEL_BOUNCE_SIZE, MALLOC_CAP_DMA);
+        if (qspi_panel_obj->bounce[i] == NULL) {
+            mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("Failed to allocate DMA bounce buffer."));
+        }
+        qspi_panel_obj->bounce_seq[i] = 0;
+    }
+    qspi_panel_obj->bounce_next = 0;
+    memset(&qspi_panel_obj->stats, 0, sizeof(qspi_panel_obj->stats));
+
+    if (qspi_panel_obj->worker) {
+        hal_lcd_qspi_panel_worker_start(qspi_panel_obj);
+    }
+}
+
+
+// Transactions queued or handed to the worker that are not done yet.
+STATIC uint32_t hal_lcd_qspi_panel_inflight(mp_lcd_qspi_panel_obj_t *qspi_panel_obj)
+{
+    if (qspi_panel_obj->worker) {
+        return lcd_spsc_count(&qspi_panel_obj->worker_queue);
+    }
+    return qspi_panel_obj->trans_inflight;
+}
+
+
+// Record the chunks finished since the last call on the dma track, from when
+// they were handed over or the transaction before them was done, whichever
+// is later, to when they were done. Runs before a slot is filled again, so
+// its timestamps are still those of the finished transaction.
+STATIC void hal_lcd_qspi_panel_trace_done(mp_lcd_qspi_panel_obj_t *qspi_panel_obj)
+{
+#if LCD_TRACE
+    int depth = qspi_panel_obj->worker ? QSPI_PANEL_WORKER_DEPTH : QSPI_PANEL_QUEUE_DEPTH;
+    uint32_t completed = hal_lcd_qspi_panel_completed(qspi_panel_obj);
+
+    while (qspi_panel_obj->trace_seq != completed) {
+        int i = qspi_panel_obj->trace_slot;
+        spi_transaction_ext_t *t = &qspi_panel_obj->trans[i];
+        // pixel data goes out in qio mode, the commands do not
+        if (lcd_trace_enabled && (t->base.flags & SPI_TRANS_MODE_QIO)) {
+            uint32_t start = qspi_panel_obj->trans_queued_us[i];
+            if ((int32_t)(qspi_panel_obj->trace_end_us - start) > 0) {
+                start = qspi_panel_obj->trace_end_us;
+            }
+            lcd_trace_record_at(MP_QSTR_chunk, LCD_TRACE_DMA, 'B', 0, start);
+            lcd_trace_record_at(MP_QSTR_chunk, LCD_TRACE_DMA, 'E', t->base.length / 8,
+                                qspi_panel_obj->trans_end_us[i]);
+        }
+        qspi_panel_obj->trace_end_us = qspi_panel_obj->trans_end_us[i];
+        qspi_panel_obj->trace_slot = (i + 1) % depth;
+        qspi_panel_obj->trace_seq++;
+    }
+#endif
+}
+
+
+// Block until the oldest queued transaction is done.
+STATIC void hal_lcd_qspi_panel_reap(mp_lcd_qspi_panel_obj_t *qspi_panel_obj)
+{
+    spi_transaction_t *done;
+    int64_t start = esp_timer_get_time();
+    LCD_TRACE_BEGIN(MP_QSTR_wait, LCD_TRACE_BUS);
+    if (qspi_panel_obj->worker) {
+        // the other core is sending it, a full chunk takes close to a
+        // millisecond, so sleep until the worker is done with one
+        uint32_t oldest = qspi_panel_obj->trans_seq - lcd_spsc_count(&qspi_panel_obj->worker_queue) + 1;
+        while (!lcd_spsc_done(&qspi_panel_obj->worker_queue, oldest)) {
+            MP_THREAD_GIL_EXIT();
+            xSemaphoreTake(qspi_panel_obj->worker_popped, portMAX_DELAY);
+            MP_THREAD_GIL_ENTER();
+        }
+    } else {
+        spi_device_get_trans_result(qspi_panel_obj->io_handle, &done, portMAX_DELAY);
+        qspi_panel_obj->trans_inflight--;
+    }
+    LCD_TRACE_END(MP_QSTR_wait, LCD_TRACE_BUS, 0);
+    qspi_panel_obj->stats.blocked_us += esp_timer_get_time() - start;
+}
+
+
+// Send t and wait for it to finish.
+STATIC void hal_lcd_qspi_panel_polling_transmit(mp_lcd_qspi_panel_obj_t *qspi_panel_obj,
+                                                spi_transaction_ext_t   *t)
+{
+    int64_t start = esp_timer_get_time();
+    spi_device_polling_transmit(qspi_panel_obj->io_handle, (spi_transaction_t *)t);
+    qspi_panel_obj->stats.blocked_us += esp_timer_get_time() - start;
+}
+
+
+// Hand a copy of t to the worker, once it has a free slot.
+STATIC uint32_t hal_lcd_qspi_panel_worker_trans(mp_lcd_qspi_panel_obj_t *qspi_panel_obj,
+                                                const spi_transaction_ext_t *t,
+                                                mp_obj_t owner)
+{
+    int i;
+    while ((i = lcd_spsc_reserve(&qspi_panel_obj->worker_queue)) < 0) {
+        hal_lcd_qspi_panel_reap(qspi_panel_obj);
+    }
+    hal_lcd_qspi_panel_trace_done(qspi_panel_obj);
+    qspi_panel_obj->trans[i] = *t;
+    qspi_panel_obj->trans_owner[i] = owner;
+    qspi_panel_obj->trans_queued_us[i] = esp_timer_get_time();
+    qspi_panel_obj->trans_seq = lcd_spsc_push(&qspi_panel_obj->worker_queue);
+    xTaskNotifyGive(qspi_panel_obj->worker_task);
+    return qspi_panel_obj->trans_seq;
+}
+
+
+// Queue a copy of t into the transaction ring. When the ring is full the oldest
+// transaction is reaped first, results come back in order so its slot is free.
+STATIC uint32_t hal_lcd_qspi_panel_queue_trans(mp_lcd_qspi_panel_obj_t *qspi_panel_obj,
+                                               const spi_transaction_ext_t *t,
+                                               mp_obj_t owner)
+{
+    if (qspi_panel_obj->trans_inflight == QSPI_PANEL_QUEUE_DEPTH) {
+        hal_lcd_qspi_panel_reap(qspi_panel_obj);
+    }
+
+    hal_lcd_qspi_panel_trace_done(qspi_panel_obj);
+    spi_transaction_ext_t *slot = &qspi_panel_obj->trans[qspi_panel_obj->trans_head];
+    *slot = *t;
+    qspi_panel_obj->trans_queued_us[qspi_panel_obj->trans_head] = esp_timer_get_time();
+    slot->base.user = (void *)((uintptr_t)slot->base.user | QSPI_TRANS_QUEUED);
+    esp_err_t ret = spi_device_queue_trans(qspi_panel_obj->io_handle, (spi_transaction_t *)slot, portMAX_DELAY);
+    if (ret != 0) {
+        mp_raise_msg_varg(&mp_type_OSError, "%d(spi_device_queue_trans)", ret);
+    }
+    qspi_panel_obj->trans_owner[qspi_panel_obj->trans_head] = owner;
+    qspi_panel_obj->trans_head = (qspi_panel_obj->trans_head + 1) % QSPI_PANEL_QUEUE_DEPTH;
+    qspi_panel_obj->trans_inflight++;
+    return ++qspi_panel_obj->trans_seq;
+}
+
+
+// Returns the sequence number of the transaction, 0 when it is already done.
+// A queued transaction keeps owner, the object holding the data it reads if
+// any, reachable for the gc until its slot is reused or wait() returned.
+STATIC uint32_t hal_lcd_qspi_panel_transmit(mp_lcd_qspi_panel_obj_t *qspi_panel_obj,
+                                            spi_transaction_ext_t   *t,
+                                            mp_obj_t                 owner)
+{
+    if (qspi_panel_obj->worker) {
+        return hal_lcd_qspi_panel_worker_trans(qspi_panel_obj, t, owner);
+    }
+    if (qspi_panel_obj->queued) {
+        return hal_lcd_qspi_panel_queue_trans(qspi_panel_obj, t, owner);
+    }
+    hal_lcd_qspi_panel_polling_transmit(qspi_panel_obj, t);
+    return 0;
+}
+
+
+// Block until transaction seq is done.
+STATIC void hal_lcd_qspi_panel_wait_seq(mp_lcd_qspi_panel_obj_t *qspi_panel_obj, uint32_t seq)
+{
+    while (hal_lcd_qspi_panel_inflight(qspi_panel_obj) > 0 &&
+           (int32_t)(qspi_panel_obj->trans_seq - hal_lcd_qspi_panel_inflight(qspi_panel_obj) - seq) < 0) {
+        hal_lcd_qspi_panel_reap(qspi_panel_obj);
+    }
+}
+
+
+// Take the next bounce buffer, once the transaction still reading it is done.
+STATIC int hal_lcd_qspi_panel_bounce(mp_lcd_qspi_panel_obj_t *qspi_panel_obj)
+{
+    int i = qspi_panel_obj->bounce_next;
+
+    hal_lcd_qspi_panel_wait_seq(qspi_panel_obj, qspi_panel_obj->bounce_seq[i]);
+    qspi_panel_obj->bounce_next = (i + 1) % QSPI_PANEL_BOUNCE_BUFFERS;
+    return i;
+}
+
+
+void hal_lcd_qspi_panel_wait(mp_obj_base_t *self)
+{
+    mp_lcd_qspi_panel_obj_t *qspi_panel_obj = (mp_lcd_qspi_panel_obj_t *)self;
+
+    while (hal_lcd_qspi_panel_inflight(qspi_panel_obj) > 0) {
+        hal_lcd_qspi_panel_reap(qspi_panel_obj);
+    }
+    hal_lcd_qspi_panel_trace_done(qspi_panel_obj);
+    // nothing reads the DMABuffers any more
+    for (int i = 0; i < QSPI_PANEL_WORKER_DEPTH; i++) {
+        qspi_panel_obj->trans_owner[i] = MP_OBJ_NULL;
+    }
+}
+
+
+bool hal_lcd_qspi_panel_busy(mp_obj_base_t *self)
+{
+    mp_lcd_qspi_panel_obj_t *qspi_panel_obj = (mp_lcd_qspi_panel_obj_t *)self;
+    spi_transaction_t *done;
+
+    hal_lcd_qspi_panel_trace_done(qspi_panel_obj);
+    if (qspi_panel_obj->worker) {
+        return hal_lcd_qspi_panel_inflight(qspi_panel_obj) > 0;
+    }
+    if (qspi_panel_obj->trans_inflight == 0) {
+        return false;
+    }
+    while (qspi_panel_obj->trans_inflight > 0 &&
+           spi_device_get_trans_result(qspi_panel_obj->io_handle, &done, 0) == ESP_OK) {
+        qspi_panel_obj->trans_inflight--;
+    }
+    return qspi_panel_obj->trans_inflight > 0;
+}
+
+
+void hal_lcd_qspi_panel_notify(mp_obj_base_t *self, mp_obj_t callback, mp_obj_t arg)
+{
+    mp_lcd_qspi_panel_obj_t *qspi_panel_obj = (mp_lcd_qspi_panel_obj_t *)self;
+    uint32_t seq = qspi_panel_obj->trans_seq;
+
+    if (seq == 0 || (int32_t)(hal_lcd_qspi_panel_completed(qspi_panel_obj) - seq) >= 0) {
+        mp_sched_schedule(callback, arg);
+        return;
+    }
+    // every call gets a slot of its own, arming one never drops another
+    int i = 0;
+    while (atomic_load(&qspi_panel_obj->notify_seq[i]) != 0) {
+        if (++i == QSPI_PANEL_NOTIFY_DEPTH) {
+            mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("too many pending notify() calls"));
+        }
+    }
+    qspi_panel_obj->notify_cb[i] = callback;
+    qspi_panel_obj->notify_arg[i] = arg;
+    atomic_store(&qspi_panel_obj->notify_seq[i], seq);
+    // the transaction may have finished before it was armed
+    hal_lcd_qspi_panel_notify_check(qspi_panel_obj);
+}
+
+
+// the bounce buffers and the spi device are gone after deinit
+STATIC void hal_lcd_qspi_panel_check(mp_lcd_qspi_panel_obj_t *qspi_panel_obj)
+{
+    if (qspi_panel_obj->io_handle == NULL) {
+        mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("bus deinitialized"));
+    }
+}
+
+
+void hal_lcd_qspi_panel_source(mp_obj_base_t *self, mp_obj_t obj)
+{
+    ((mp_lcd_qspi_panel_obj_t *)self)->tx_source = obj;
 }
 
 
@@ -67,21 +650,153 @@ inline void hal_lcd_qspi_panel_tx_param(mp_obj_base_t *self,
     DEBUG_printf("hal_lcd_qspi_panel_tx_param cmd: %x, param_size: %u\n", lcd_cmd, param_size);
 
     mp_lcd_qspi_panel_obj_t *qspi_panel_obj = (mp_lcd_qspi_panel_obj_t *)self;
-    spi_transaction_t t;
+    spi_transaction_ext_t t;
+    hal_lcd_qspi_panel_check(qspi_panel_obj);
+    int64_t start = esp_timer_get_time();
+    LCD_TRACE_BEGIN(MP_QSTR_tx_param, LCD_TRACE_BUS);
+
     memset(&t, 0, sizeof(t));
-    t.flags = (SPI_TRANS_MULTILINE_CMD | SPI_TRANS_MULTILINE_ADDR);
-    t.cmd = 0x02;
-    t.addr = lcd_cmd << 8;
+    t.base.flags = (SPI_TRANS_MULTILINE_CMD | SPI_TRANS_MULTILINE_ADDR);
+    t.base.cmd = 0x02;
+    t.base.addr = lcd_cmd << 8;
+    t.base.user = QSPI_TRANS_USER(qspi_panel_obj, QSPI_TRANS_CS_ASSERT | QSPI_TRANS_CS_RELEASE);
     if (param_size != 0) {
-        t.tx_buffer = param;
-        t.length = qspi_panel_obj->cmd_bits * param_size;
+        t.base.length = qspi_panel_obj->cmd_bits * param_size;
     } else {
-        t.tx_buffer = NULL;
-        t.length = 0;
+        t.base.length = 0;
     }
-    mp_hal_pin_od_low(qspi_panel_obj->cs_pin);
-    spi_device_polling_transmit(qspi_panel_obj->io_handle, &t);
-    mp_hal_pin_od_high(qspi_panel_obj->cs_pin);
+
+    if (param_size <= sizeof(t.base.tx_data)) {
+        // short parameters (CASET, RASET, MADCTL...) are copied into the
+        // transaction, so they can be queued behind the previous transfer.
+        t.base.flags |= SPI_TRANS_USE_TXDATA;
+        if (param_size != 0) {
+            memcpy(t.base.tx_data, param, param_size);
+        }
+        hal_lcd_qspi_panel_transmit(qspi_panel_obj, &t, MP_OBJ_NULL);
+    } else {
+        // a polling transaction must not overlap queued ones
+        hal_lcd_qspi_panel_wait(self);
+        t.base.tx_buffer = param;
+        hal_lcd_qspi_panel_polling_transmit(qspi_panel_obj, &t);
+    }
+
+    qspi_panel_obj->stats.param_transactions++;
+    qspi_panel_obj->stats.param_bytes += param_size;
+    qspi_panel_obj->stats.cs_toggles++;
+    lcd_stats_hist_add(&qspi_panel_obj->stats.tx_param_us, esp_timer_get_time() - start);
+    LCD_TRACE_END(MP_QSTR_tx_param, LCD_TRACE_BUS, param_size);
+}
+
+
+// Send color_size bytes of pixel data as one memory write, cs stays asserted
+// for the whole run. The data is taken from buf over and over again, so a
+// short pattern can cover a large area without a screen sized buffer.
+// Data the dma can not read is copied through the bounce buffers here rather
+// than leaving it to the spi driver, which would malloc a copy per chunk.
+STATIC void hal_lcd_qspi_panel_tx_ramwr(mp_lcd_qspi_panel_obj_t *qspi_panel_obj,
+                                        const uint8_t           *buf,
+                                        size_t                   buf_size,
+                                        size_t                   color_size)
+{
+    spi_transaction_ext_t t;
+    size_t chunk_size;
+    size_t sent = 0;
+    uintptr_t cs_flags = QSPI_TRANS_CS_ASSERT;
+    bool stage = !hal_lcd_dma_capable(buf);
+    int pattern_bounce = -1;
+    // the buffer is usually a slice of source, which does not keep it alive
+    mp_obj_t source = qspi_panel_obj->tx_source;
+    qspi_panel_obj->tx_source = MP_OBJ_NULL;
+
+    if (stage && buf_size < color_size && buf_size <= QSPI_PANEL_BOUNCE_SIZE) {
+        // a repeated pattern is staged only once
+        pattern_bounce = hal_lcd_qspi_panel_bounce(qspi_panel_obj);
+        memcpy(qspi_panel_obj->bounce[pattern_bounce], buf, buf_size);
+        buf = qspi_panel_obj->bounce[pattern_bounce];
+        stage = false;
+        qspi_panel_obj->stats.staged_bytes += buf_size;
+    }
+    mp_lcd_dma_buffer_obj_t *owner = stage ? NULL : hal_lcd_dma_owner(buf);
+
+    do {
+        size_t offset = buf_size ? sent % buf_size : 0;
+        int bounce = pattern_bounce;
+        mp_lcd_dma_buffer_obj_t *reads = NULL;
+        mp_obj_t keep = MP_OBJ_NULL;
+        chunk_size = color_size - sent;
+        if (chunk_size > qspi_panel_obj->chunk_size) {
+            chunk_size = qspi_panel_obj->chunk_size;
+        }
+        if (chunk_size > buf_size - offset) {
+            chunk_size = buf_size - offset;
+        }
+        if (stage && chunk_size > QSPI_PANEL_BOUNCE_SIZE) {
+            chunk_size = QSPI_PANEL_BOUNCE_SIZE;
+        }
+        if (sent + chunk_size == color_size) {
+            cs_flags |= QSPI_TRANS_CS_RELEASE;
+        }
+
+        memset(&t, 0, sizeof(t));
+        if (cs_flags & QSPI_TRANS_CS_ASSERT) {
+            // the memory write command goes out together with the first chunk
+            t.base.flags = SPI_TRANS_MODE_QIO;
+            t.base.cmd = 0x32;
+            t.base.addr = 0x002C00;
+        } else {
+            t.base.flags = SPI_TRANS_MODE_QIO | \
+                            SPI_TRANS_VARIABLE_CMD | \
+                            SPI_TRANS_VARIABLE_ADDR | \
+                            SPI_TRANS_VARIABLE_DUMMY;
+            t.command_bits = 0;
+            t.address_bits = 0;
+            t.dummy_bits = 0;
+        }
+        if (chunk_size <= sizeof(t.base.tx_data)) {
+            // small payloads (e.g. a single pixel) usually live on the caller's
+            // stack, copy them into the transaction so they survive a queued send.
+            t.base.flags |= SPI_TRANS_USE_TXDATA;
+            if (chunk_size != 0) {
+                memcpy(t.base.tx_data, buf + offset, chunk_size);
+            }
+        } else if (stage) {
+            bounce = hal_lcd_qspi_panel_bounce(qspi_panel_obj);
+            memcpy(qspi_panel_obj->bounce[bounce], buf + offset, chunk_size);
+            t.base.tx_buffer = qspi_panel_obj->bounce[bounce];
+            qspi_panel_obj->stats.staged_bytes += chunk_size;
+        } else {
+            t.base.tx_buffer = buf + offset;
+            reads = owner;
+            keep = reads ? MP_OBJ_FROM_PTR(reads) : source;
+        }
+        t.base.length = chunk_size * 8;
+        t.base.user = QSPI_TRANS_USER(qspi_panel_obj, cs_flags);
+        // queued chunks are recorded on the dma track once they are done
+        bool polled = !qspi_panel_obj->queued && !qspi_panel_obj->worker;
+        if (polled) {
+            LCD_TRACE_BEGIN(MP_QSTR_chunk, LCD_TRACE_BUS);
+        }
+        uint32_t seq = hal_lcd_qspi_panel_transmit(qspi_panel_obj, &t, keep);
+        if (polled) {
+            LCD_TRACE_END(MP_QSTR_chunk, LCD_TRACE_BUS, chunk_size);
+        }
+        if (bounce >= 0) {
+            qspi_panel_obj->bounce_seq[bounce] = seq;
+        }
+        if (reads) {
+            // free() of the buffer waits for this one
+            reads->panel = &qspi_panel_obj->base;
+            reads->seq = seq;
+        }
+        sent += chunk_size;
+        cs_flags = 0;
+        qspi_panel_obj->stats.chunks++;
+    } while (sent < color_size);
+
+    qspi_panel_obj->stats.color_transactions++;
+    qspi_panel_obj->stats.color_bytes += color_size;
+    qspi_panel_obj->stats.cs_toggles++;
 }
 
 
@@ -93,47 +808,163 @@ inline void hal_lcd_qspi_panel_tx_color(mp_obj_base_t *self,
     DEBUG_printf("hal_lcd_qspi_panel_tx_color cmd:, color_size: %u\n", /* lcd_cmd, */ color_size);
 
     mp_lcd_qspi_panel_obj_t *qspi_panel_obj = (mp_lcd_qspi_panel_obj_t *)self;
-    spi_transaction_ext_t t;
+    hal_lcd_qspi_panel_check(qspi_panel_obj);
+    int64_t start = esp_timer_get_time();
+    hal_lcd_qspi_panel_tx_ramwr(qspi_panel_obj, (const uint8_t *)color, color_size, color_size);
+    lcd_stats_hist_add(&qspi_panel_obj->stats.tx_color_us, esp_timer_get_time() - start);
+}
 
-    mp_hal_pin_od_low(qspi_panel_obj->cs_pin);
-    memset(&t, 0, sizeof(t));
-    t.base.flags = SPI_TRANS_MODE_QIO;
-    t.base.cmd = 0x32;
-    t.base.addr = 0x002C00;
-    spi_device_polling_transmit(qspi_panel_obj->io_handle, (spi_transaction_t *)&t);
 
-    uint8_t *p_color = (uint8_t *)color;
-    size_t chunk_size;
-    size_t len = color_size;
-    memset(&t, 0, sizeof(t));
-    t.base.flags = SPI_TRANS_MODE_QIO | \
-                    SPI_TRANS_VARIABLE_CMD | \
-                    SPI_TRANS_VARIABLE_ADDR | \
-                    SPI_TRANS_VARIABLE_DUMMY;
-    t.command_bits = 0;
-    t.address_bits = 0;
-    t.dummy_bits = 0;
-    
-    do {
-        if (len > 0x8000) { //32 KB
-            chunk_size = 0x8000;
-        } else {
-            chunk_size = len;
-        }
-        t.base.tx_buffer = p_color;
-        t.base.length = chunk_size * 8;
-        spi_device_polling_transmit(qspi_panel_obj->io_handle, (spi_transaction_t *)&t);
-        len -= chunk_size;
-        p_color += chunk_size;
-    } while (len > 0);
+inline void hal_lcd_qspi_panel_tx_pattern(mp_obj_base_t *self,
+                                          int            lcd_cmd,
+                                          const void    *pattern,
+                                          size_t         pattern_size,
+                                          size_t         color_size)
+{
+    DEBUG_printf("hal_lcd_qspi_panel_tx_pattern pattern_size: %u, color_size: %u\n", pattern_size, color_size);
 
-    mp_hal_pin_od_high(qspi_panel_obj->cs_pin);
+    mp_lcd_qspi_panel_obj_t *qspi_panel_obj = (mp_lcd_qspi_panel_obj_t *)self;
+    hal_lcd_qspi_panel_check(qspi_panel_obj);
+    int64_t start = esp_timer_get_time();
+    hal_lcd_qspi_panel_tx_ramwr(qspi_panel_obj, (const uint8_t *)pattern, pattern_size, color_size);
+    lcd_stats_hist_add(&qspi_panel_obj->stats.tx_pattern_us, esp_timer_get_time() - start);
+}
+
+
+// Send nbytes of black pixels to the current window in chunks of chunk_size
+// and return how long it took in us, including waiting for the last chunk.
+int64_t hal_lcd_qspi_panel_measure(mp_obj_base_t *self, uint32_t chunk_size, size_t nbytes)
+{
+    mp_lcd_qspi_panel_obj_t *qspi_panel_obj = (mp_lcd_qspi_panel_obj_t *)self;
+
+    hal_lcd_qspi_panel_check(qspi_panel_obj);
+    if (chunk_size == 0 || chunk_size > qspi_panel_obj->max_transfer_sz || chunk_size % 4 != 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("chunk_size must be a multiple of 4 up to max_transfer_sz"));
+    }
+    uint8_t *pattern = heap_caps_malloc(chunk_size, MALLOC_CAP_DMA);
+    if (pattern == NULL) {
+        mp_raise_msg(&mp_type_MemoryError, MP_ERROR_TEXT("Failed to allocate DMA pattern."));
+    }
+    memset(pattern, 0, chunk_size);
+
+    uint32_t saved = qspi_panel_obj->chunk_size;
+    qspi_panel_obj->chunk_size = chunk_size;
+    hal_lcd_qspi_panel_wait(self);
+
+    // the chunk size and the pattern are given back even if a transfer fails,
+    // once the chunks queued before are done reading the pattern
+    nlr_buf_t nlr;
+    int64_t elapsed = 0;
+    if (nlr_push(&nlr) == 0) {
+        int64_t start = esp_timer_get_time();
+        hal_lcd_qspi_panel_tx_ramwr(qspi_panel_obj, pattern, chunk_size, nbytes);
+        hal_lcd_qspi_panel_wait(self);
+        elapsed = esp_timer_get_time() - start;
+        nlr_pop();
+    } else {
+        hal_lcd_qspi_panel_wait(self);
+        qspi_panel_obj->chunk_size = saved;
+        heap_caps_free(pattern);
+        nlr_jump(nlr.ret_val);
+    }
+
+    qspi_panel_obj->chunk_size = saved;
+    heap_caps_free(pattern);
+    return elapsed;
 }
 
 
 inline void hal_lcd_qspi_panel_deinit(mp_obj_base_t *self)
 {
-    // mp_lcd_qspi_panel_obj_t *qspi_panel_obj = (mp_lcd_qspi_panel_obj_t *)self;
-    // esp_lcd_panel_io_del(qspi_panel_obj->io_handle);
+    mp_lcd_qspi_panel_obj_t *qspi_panel_obj = (mp_lcd_qspi_panel_obj_t *)self;
+
+    hal_lcd_qspi_panel_wait(self);
+    if (qspi_panel_obj->worker_task) {
+        atomic_store(&qspi_panel_obj->worker_stop, true);
+        xTaskNotifyGive(qspi_panel_obj->worker_task);
+        while (!atomic_load(&qspi_panel_obj->worker_done)) {
+            vTaskDelay(1);
+        }
+        qspi_panel_obj->worker_task = NULL;
+    }
+    if (qspi_panel_obj->worker_popped) {
+        vSemaphoreDelete(qspi_panel_obj->worker_popped);
+        qspi_panel_obj->worker_popped = NULL;
+    }
+    for (int i = 0; i < QSPI_PANEL_BOUNCE_BUFFERS; i++) {
+        heap_caps_free(qspi_panel_obj->bounce[i]);
+        qspi_panel_obj->bounce[i] = NULL;
+    }
+    hal_lcd_dma_release_panel(self);
+    // give the bus back, so the SPI object can be set up again
+    if (qspi_panel_obj->io_handle) {
+        machine_hw_spi_obj_t *spi_obj = ((machine_hw_spi_obj_t *)qspi_panel_obj->spi_obj);
+        spi_bus_remove_device(qspi_panel_obj->io_handle);
+        qspi_panel_obj->io_handle = NULL;
+        spi_bus_free(spi_obj->host);
+        spi_obj->state = MACHINE_HW_SPI_STATE_DEINIT;
+    }
+}
+
+
+
+// te
+// The rising edge of the TE pin gives a binary semaphore from the gpio
+// interrupt, so waiting for it sleeps instead of polling the pin.
+STATIC void IRAM_ATTR hal_lcd_te_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR((SemaphoreHandle_t)arg, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+
+void *hal_lcd_te_attach(mp_obj_t pin)
+{
+    gpio_num_t gpio = mp_hal_get_pin_obj(pin);
+    SemaphoreHandle_t edge = xSemaphoreCreateBinary();
+    if (edge == NULL) {
+        mp_raise_msg(&mp_type_MemoryError, MP_ERROR_TEXT("Failed to create the TE semaphore."));
+    }
+
+    // machine.Pin installs the service at boot already
+    esp_err_t ret = gpio_install_isr_service(0);
+    if (ret == ESP_OK || ret == ESP_ERR_INVALID_STATE) {
+        gpio_set_intr_type(gpio, GPIO_INTR_POSEDGE);
+        ret = gpio_isr_handler_add(gpio, hal_lcd_te_isr, edge);
+    }
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(edge);
+        mp_raise_msg_varg(&mp_type_OSError, "%d(gpio_isr_handler_add)", ret);
+    }
+    gpio_intr_enable(gpio);
+    return edge;
 }
 
+
+// Wait for the next rising edge, at most timeout_us. An edge that came before
+// the call is dropped, that pulse started too long ago. Other threads run
+// meanwhile, and pending exceptions are raised once the wait is over.
+bool hal_lcd_te_wait(void *te, uint32_t timeout_us)
+{
+    SemaphoreHandle_t edge = te;
+    xSemaphoreTake(edge, 0);
+
+    MP_THREAD_GIL_EXIT();
+    bool seen = xSemaphoreTake(edge, pdMS_TO_TICKS((timeout_us + 999) / 1000) + 1) == pdTRUE;
+    MP_THREAD_GIL_ENTER();
+
+    mp_handle_pending(true);
+    return seen;
+}
+
+
+void hal_lcd_te_detach(mp_obj_t pin, void *te)
+{
+    gpio_num_t gpio = mp_hal_get_pin_obj(pin);
+    gpio_isr_handler_remove(gpio);
+    gpio_set_intr_type(gpio, GPIO_INTR_DISABLE);
+    vSemaphoreDelete((SemaphoreHandle_t)te);
+}
@@ -3,6 +3,13 @@
 
 #include "py/obj.h"
 
+// dma pool
+void *hal_lcd_dma_alloc(mp_obj_base_t *owner, size_t size, size_t pool_size);
+
+void hal_lcd_dma_free(void *ptr);
+
+bool hal_lcd_dma_capable(const void *ptr);
+
 // qspi
 void hal_lcd_qspi_panel_construct(mp_obj_base_t *self);
 
@@ -20,8 +27,33 @@ void hal_lcd_qspi_panel_tx_color(
     size_t color_size
 );
 
+void hal_lcd_qspi_panel_tx_pattern(
+    mp_obj_base_t *self,
+    int lcd_cmd,
+    const void *pattern,
+    size_t pattern_size,
+    size_t color_size
+);
+
+int64_t hal_lcd_qspi_panel_measure(mp_obj_base_t *self, uint32_t chunk_size, size_t nbytes);
+
 void hal_lcd_qspi_panel_deinit(mp_obj_base_t *self);
 
+void hal_lcd_qspi_panel_wait(mp_obj_base_t *self);
+
+bool hal_lcd_qspi_panel_busy(mp_obj_base_t *self);
+
+void hal_lcd_qspi_panel_notify(mp_obj_base_t *self, mp_obj_t callback, mp_obj_t arg);
+
+void hal_lcd_qspi_panel_source(mp_obj_base_t *self, mp_obj_t obj);
+
+// te
+void *hal_lcd_te_attach(mp_obj_t pin);
+
+bool hal_lcd_te_wait(void *te, uint32_t timeout_us);
+
+void hal_lcd_te_detach(mp_obj_t pin, void *te);
+
 void hal_lcd_dpi_mirror(mp_obj_base_t *self, bool mirror_x, bool mirror_y);
 
 void hal_lcd_dpi_swap_xy(mp_obj_base_t *self, bool swap_axes);
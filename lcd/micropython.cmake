@@ -13,13 +13,14 @@ set(ESP32_HAL_INC ${HAL_DIR}/esp32)
 
 # bus layer
 set(BUS_DIR ${CMAKE_CURRENT_LIST_DIR}/bus)
+set(COMMON_BUS_SRC ${BUS_DIR}/common/lcd_panel_stats.c ${BUS_DIR}/common/lcd_trace.c)
 set(COMMON_BUS_INC ${BUS_DIR}/common)
 set(QSPI_BUS_SRC ${BUS_DIR}/qspi/qspi_panel.c)
 set(QSPI_BUS_INC ${BUS_DIR}/qspi)
 
 # driver layer
 set(DRIVER_DIR ${CMAKE_CURRENT_LIST_DIR}/driver)
-set(DRIVER_COMMON_SRC ${DRIVER_DIR}/common/lcd_panel_types.c)
+set(DRIVER_COMMON_SRC ${DRIVER_DIR}/common/lcd_panel_types.c ${DRIVER_DIR}/common/lcd_panel_convert.c ${DRIVER_DIR}/common/display_list.c ${DRIVER_DIR}/common/lcd_font.c ${DRIVER_DIR}/common/lcd_assets.c ${DRIVER_DIR}/common/lcd_image.c)
 set(DRIVER_COMMON_INC ${DRIVER_DIR}/common)
 set(RM67162_DRIVER_SRC ${DRIVER_DIR}/rm67162/rm67162.c)
 set(RM67162_DRIVER_INC ${DRIVER_DIR}/rm67162)
@@ -27,6 +28,7 @@ set(RM67162_DRIVER_INC ${DRIVER_DIR}/rm67162)
 # Add our source files to the lib
 set(SRC ${CMAKE_CURRENT_LIST_DIR}/modlcd.c)
 LIST(APPEND SRC ${ESP32_HAL_SRC})
+LIST(APPEND SRC ${COMMON_BUS_SRC})
 LIST(APPEND SRC ${QSPI_BUS_SRC})
 LIST(APPEND SRC ${DRIVER_COMMON_SRC})
 LIST(APPEND SRC ${RM67162_DRIVER_SRC})
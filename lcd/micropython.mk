@@ -0,0 +1,26 @@
+# Make based ports (e.g. unix) only get the emulated bus, the esp32 port
+# builds through micropython.cmake.
+LCD_MOD_DIR := $(USERMOD_DIR)
+
+# bus layer
+SRC_USERMOD += $(LCD_MOD_DIR)/bus/common/lcd_panel_stats.c
+SRC_USERMOD += $(LCD_MOD_DIR)/bus/common/lcd_trace.c
+SRC_USERMOD += $(LCD_MOD_DIR)/bus/emulated/emulated_panel.c
+
+# driver layer
+SRC_USERMOD += $(LCD_MOD_DIR)/driver/common/lcd_panel_types.c
+SRC_USERMOD += $(LCD_MOD_DIR)/driver/common/lcd_panel_convert.c
+SRC_USERMOD += $(LCD_MOD_DIR)/driver/common/display_list.c
+SRC_USERMOD += $(LCD_MOD_DIR)/driver/common/lcd_font.c
+SRC_USERMOD += $(LCD_MOD_DIR)/driver/common/lcd_assets.c
+SRC_USERMOD += $(LCD_MOD_DIR)/driver/common/lcd_image.c
+SRC_USERMOD += $(LCD_MOD_DIR)/driver/rm67162/rm67162.c
+
+SRC_USERMOD += $(LCD_MOD_DIR)/modlcd.c
+
+CFLAGS_USERMOD += -I$(LCD_MOD_DIR)
+CFLAGS_USERMOD += -I$(LCD_MOD_DIR)/bus/common
+CFLAGS_USERMOD += -I$(LCD_MOD_DIR)/bus/emulated
+CFLAGS_USERMOD += -I$(LCD_MOD_DIR)/driver/common
+CFLAGS_USERMOD += -I$(LCD_MOD_DIR)/driver/rm67162
+CFLAGS_USERMOD += -DEMULATED_LCD_SUPPORTED=1
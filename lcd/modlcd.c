@@ -1,16 +1,41 @@
 #include "rm67162.h"
+#if USE_ESP_LCD
 #include "qspi_panel.h"
+#endif
+#if EMULATED_LCD_SUPPORTED
+#include "emulated_panel.h"
+#endif
 #include "lcd_panel_types.h"
+#include "lcd_panel_convert.h"
+#include "display_list.h"
+#include "lcd_assets.h"
+#include "lcd_trace.h"
 
 #include "py/obj.h"
 
 STATIC const mp_map_elem_t mp_module_lcd_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__),   MP_OBJ_NEW_QSTR(MP_QSTR_lcd)          },
     { MP_ROM_QSTR(MP_QSTR_RM67162),    (mp_obj_t)&mp_lcd_rm67162_type        },
+#if USE_ESP_LCD
     { MP_ROM_QSTR(MP_QSTR_QSPIPanel),  (mp_obj_t)&mp_lcd_qspi_panel_type     },
+#endif
+#if EMULATED_LCD_SUPPORTED
+    { MP_ROM_QSTR(MP_QSTR_EmulatedPanel), (mp_obj_t)&mp_lcd_emulated_panel_type },
+#endif
+    { MP_ROM_QSTR(MP_QSTR_DisplayList), (mp_obj_t)&mp_lcd_display_list_type },
+    { MP_ROM_QSTR(MP_QSTR_Assets),     (mp_obj_t)&mp_lcd_assets_type         },
+#if LCD_TRACE
+    { MP_ROM_QSTR(MP_QSTR_trace_start), (mp_obj_t)&lcd_trace_start_obj },
+    { MP_ROM_QSTR(MP_QSTR_trace_stop), (mp_obj_t)&lcd_trace_stop_obj },
+    { MP_ROM_QSTR(MP_QSTR_trace_dump), (mp_obj_t)&lcd_trace_dump_obj },
+#endif
     { MP_ROM_QSTR(MP_QSTR_RGB),        MP_ROM_INT(COLOR_SPACE_RGB)           },
     { MP_ROM_QSTR(MP_QSTR_BGR),        MP_ROM_INT(COLOR_SPACE_BGR)           },
     { MP_ROM_QSTR(MP_QSTR_MONOCHROME), MP_ROM_INT(COLOR_SPACE_MONOCHROME)    },
+    { MP_ROM_QSTR(MP_QSTR_RGB565),     MP_ROM_INT(PIXEL_FORMAT_RGB565)         },
+    { MP_ROM_QSTR(MP_QSTR_RGB565_SWAPPED), MP_ROM_INT(PIXEL_FORMAT_RGB565_SWAPPED) },
+    { MP_ROM_QSTR(MP_QSTR_RGB666),     MP_ROM_INT(PIXEL_FORMAT_RGB666)         },
+    { MP_ROM_QSTR(MP_QSTR_RGB888),     MP_ROM_INT(PIXEL_FORMAT_RGB888)         },
 };
 STATIC MP_DEFINE_CONST_DICT(mp_module_lcd_globals, mp_module_lcd_globals_table);
 